@@ -3,18 +3,25 @@
 #include <iomanip>
 #include <chrono>
 #include <fstream>
+#include <cstring>
 
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <gmpxx.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 
 #include "client.hpp"
 #include "ggm.h"
 #include "graph.hpp"
+#include "hub_labels.hpp"
+#include "landmarks.hpp"
+#include "contraction.hpp"
 #include "crypto_stuff.hpp"
 #include "data_structures.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 
@@ -30,7 +37,9 @@ void Client::load_dpv(const string &filePath)
 
 void Client::load_de(const string &filePath)
 {
-    if(!load_De(filePath, this->D_e)) {cerr << "Loading D_e failed." << endl;};
+    if (load_De(filePath, this->D_e)) { return; }
+    // Graphs encrypted by enc_graph_stream are split into shards next to it.
+    if(!load_De_shards(boost::filesystem::path(filePath).parent_path(), this->D_e)) {cerr << "Loading D_e failed." << endl;};
 }
 
 void Client::save_dcv(const string &filePath)
@@ -48,7 +57,27 @@ void Client::save_de(const string &filePath)
     if (!save_De(filePath, this->D_e)) { cerr << "Saving D_e failed." << endl;};
 }
 
-void Client::update_graph(const std::string &src, const std::string &dest, const size_t weight, int op)
+void Client::save_dl(const string &filePath)
+{
+    if (!save_De(filePath, this->D_l)) { cerr << "Saving D_l failed." << endl;};
+}
+
+bool Client::load_dl(const string &filePath)
+{
+    return load_De(filePath, this->D_l);
+}
+
+void Client::save_da(const string &filePath)
+{
+    if (!save_De(filePath, this->D_a)) { cerr << "Saving D_a failed." << endl;};
+}
+
+bool Client::load_da(const string &filePath)
+{
+    return load_De(filePath, this->D_a);
+}
+
+void Client::update_graph(const std::string &src, const std::string &dest, const size_t weight, int op, U_ITEM *update)
 {
     auto timer_client_start = chrono::high_resolution_clock::now();
     unsigned char F_1_s[KEY_SIZE] = {0};
@@ -58,13 +87,13 @@ void Client::update_graph(const std::string &src, const std::string &dest, const
     unsigned char F_2_t[KEY_SIZE] = {0};
     unsigned char P_t[KEY_SIZE] = {0};
 
-    F((unsigned char *)sk.k_1.c_str(), sk.k_1.size(), (unsigned char *)src.c_str(), src.size(), F_1_s);
-    F((unsigned char *)sk.k_2.c_str(), sk.k_2.size(), (unsigned char *)src.c_str(), src.size(), F_2_s);
-    F((unsigned char *)sk.k_3.c_str(), sk.k_3.size(), (unsigned char *)src.c_str(), src.size(), P_s);
+    F(sk.f_1, (const unsigned char *)src.data(), src.size(), F_1_s);
+    F(sk.f_2, (const unsigned char *)src.data(), src.size(), F_2_s);
+    F(sk.f_3, (const unsigned char *)src.data(), src.size(), P_s);
 
-    F((unsigned char *)sk.k_1.c_str(), sk.k_1.size(), (unsigned char *)dest.c_str(), src.size(), F_1_t);
-    F((unsigned char *)sk.k_2.c_str(), sk.k_2.size(), (unsigned char *)dest.c_str(), src.size(), F_2_t);
-    F((unsigned char *)sk.k_3.c_str(), sk.k_3.size(), (unsigned char *)dest.c_str(), src.size(), P_t);
+    F(sk.f_1, (const unsigned char *)dest.data(), dest.size(), F_1_t);
+    F(sk.f_2, (const unsigned char *)dest.data(), dest.size(), F_2_t);
+    F(sk.f_3, (const unsigned char *)dest.data(), dest.size(), P_t);
 
     if (op == SEC_GDB_UPDATE_OP_ADD)
     {
@@ -82,24 +111,17 @@ void Client::update_graph(const std::string &src, const std::string &dest, const
         ggm_find_best_range_cover(&ggm, (char*)this->D_cv[src].master_key.c_str(), this->D_cv[src].ctr - 1, this->D_cv[src].ctr - 1, &con);
         ggm_derive(&ggm, &con, &subk);
 
-        unsigned char UT[KEY_SIZE] = {0};
-        unsigned char mask[KEY_SIZE] = {0};
+        EDGE_TOKEN_CTX token_ctx;
+        edge_token_init(token_ctx, F_1_s, KEY_SIZE);
 
-        H_1(F_1_s, KEY_SIZE, (unsigned char*)subk.keys[0], KEY_SIZE, UT);
-        H_2(F_1_s, KEY_SIZE, (unsigned char *)subk.keys[0], KEY_SIZE, mask);
+        unsigned char token[EDGE_TOKEN_SIZE] = {0};
+        edge_token(token_ctx, (unsigned char*)subk.keys[0], KEY_SIZE, token);
+        unsigned char *UT = token;
+        unsigned char *mask = token + KEY_SIZE;
 
         mpz_class w(weight);
-        string weight_str = let_mpz_raw_to_str(w.get_mpz_t());
-
-        unsigned char data[KEY_SIZE * 2 + weight_str.size()] = {0};
-
-        std::copy(P_t, P_t + KEY_SIZE, data);
-        std::copy(F_1_t, F_1_t + KEY_SIZE, data + KEY_SIZE);
-        std::copy(weight_str.begin(), weight_str.end(), data + 2 * KEY_SIZE);
-
-        unsigned char data_masked[KEY_SIZE * 2 + weight_str.size()] = {0};
-
-        masking(data, sizeof(data), mask, sizeof(mask), data_masked);
+        string record;
+        mask_edge_record(P_t, F_1_t, w.get_mpz_t(), mask, record);
 
         auto timer_client_finish = chrono::high_resolution_clock::now();
         chrono::duration<double> time_client = timer_client_finish - timer_client_start;
@@ -121,7 +143,11 @@ void Client::update_graph(const std::string &src, const std::string &dest, const
         // Update server.
         auto timer_server_start = chrono::high_resolution_clock::now();
 
-        this->D_e[string((char *)UT, sizeof(UT))] = string((char *)data_masked, sizeof(data_masked));
+        if (update != nullptr)
+        {
+            *update = U_ITEM{string((char *)UT, KEY_SIZE), record, str_P_s, this->D_cv[src].ctr};
+        }
+        this->D_e[string((char *)UT, KEY_SIZE)] = std::move(record);
 
         auto timer_server_finish = chrono::high_resolution_clock::now();
         chrono::duration<double> time_server = timer_server_finish - timer_server_start;
@@ -163,139 +189,500 @@ Request Client::give_request(std::string src, std::string dest)
     
     unsigned char F_1_s[KEY_SIZE];
     unsigned char P_s[KEY_SIZE];
+    unsigned char F_1_t[KEY_SIZE];
     unsigned char P_t[KEY_SIZE];
 
-    F((unsigned char*)sk.k_1.c_str(), sk.k_1.length(), (unsigned char*)src.c_str(), src.length(), F_1_s);
-    F((unsigned char*)sk.k_3.c_str(), sk.k_3.length(), (unsigned char*)src.c_str(), src.length(), P_s);
-    F((unsigned char*)sk.k_3.c_str(), sk.k_3.length(), (unsigned char*)dest.c_str(), dest.length(), P_t);
+    F(sk.f_1, (const unsigned char*)src.data(), src.length(), F_1_s);
+    F(sk.f_3, (const unsigned char*)src.data(), src.length(), P_s);
+    F(sk.f_1, (const unsigned char*)dest.data(), dest.length(), F_1_t);
+    F(sk.f_3, (const unsigned char*)dest.data(), dest.length(), P_t);
 
     rtn.F_1_s = string((char*)F_1_s, KEY_SIZE);
     rtn.P_s = string((char*)P_s, KEY_SIZE);
+    rtn.F_1_t = string((char*)F_1_t, KEY_SIZE);
     rtn.P_t = string((char*)P_t, KEY_SIZE);
 
     return rtn;
 }
 
-void Client::enc_graph(const string &file_path, int scaler)
+void Client::label_vertices(const CSRGraph<size_t> &graph, ThreadPool &pool, VERTEX_LABELS &labels)
 {
-    build_graph(this->graph, file_path);
+    size_t n = graph.num_vertices();
+    labels.F_1.resize(n * KEY_SIZE);
+    labels.F_2.resize(n * KEY_SIZE);
+    labels.P.resize(n * KEY_SIZE);
+
+    pool.parallel_for(n, 1024, [&](size_t begin, size_t end, int) {
+        F_batch(this->sk.f_1, &graph.names[begin], end - begin, labels.F_1.data() + begin * KEY_SIZE);
+        F_batch(this->sk.f_2, &graph.names[begin], end - begin, labels.F_2.data() + begin * KEY_SIZE);
+        F_batch(this->sk.f_3, &graph.names[begin], end - begin, labels.P.data() + begin * KEY_SIZE);
+    });
+}
 
-    size_t base = 1 << scaler;
+void Client::enc_vertex(const CSRGraph<size_t> &graph, const VERTEX_LABELS &labels, uint32_t v, size_t base,
+                        gmp_randstate_t rand_st, ENC_SHARD &shard)
+{
+    size_t ctr = graph.out_degree(v);
+    const string &name = graph.names[v];
+
+    // F_1(u), F_2(u) and P(u).
+    const unsigned char *F_1_u = labels.F_1.data() + (size_t)v * KEY_SIZE;
+    const unsigned char *F_2_u = labels.F_2.data() + (size_t)v * KEY_SIZE;
+    const unsigned char *P_u = labels.P.data() + (size_t)v * KEY_SIZE;
+
+    shard.D_cv[name] = V_ITEM{ctr, string((char*)F_2_u, KEY_SIZE)};
+    shard.D_pv[string((char*)P_u, KEY_SIZE)] = V_ITEM{ctr, string((char*)F_2_u, KEY_SIZE)};
+    shard.D_v2p[name] = string((char*)P_u, KEY_SIZE);
+
+    // The following operations should be done under the condition 
+    // that current vertex out degree is not 0, so we have to check v's out degree.
+    if (ctr == 0)
+    {
+        return;
+    }
+
+    // In here all of constrained keys have been generated, a little different
+    // from the design in the paper.
+    // Namely for each QT_i has got and been stored in sub_keys.
+    GGM ggm;
+    ggm.key_size = KEY_SIZE;
+    ggm.n = MAX_GGM_DEPTH;
+
+    Constrain constrain;
 
-    for (auto v : this->graph.vertices)
+    ggm_find_best_range_cover(&ggm, (char*)F_2_u, 0, ctr - 1, &constrain);
+
+    Subkeys sub_keys;
+
+    ggm_derive(&ggm, &constrain, &sub_keys);
+
+    // All the edge tokens of v are keyed by F_1(u), get them in one go.
+    EDGE_TOKEN_CTX token_ctx;
+    edge_token_init(token_ctx, F_1_u, KEY_SIZE);
+
+    vector<unsigned char> tokens(ctr * EDGE_TOKEN_SIZE);
+    edge_tokens(token_ctx, sub_keys.keys, ctr, KEY_SIZE, tokens.data());
+
+    mpz_class weight;
+    int i = 0;
+    for (size_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++)
     {
-        size_t ctr = v.second.out_degree;
+        uint32_t dest = graph.targets[e];
+
+        //Firstly, encrypt the weight of the each edge of the vertex v.
+        size_t weight_scaler = (size_t)(float(graph.weights[e]) * float(base));
 
-        unsigned char F_1_u[KEY_SIZE] = {0};
-        unsigned char F_2_u[KEY_SIZE] = {0};
-        unsigned char P_u[KEY_SIZE] = {0};
+        JL_encryption(this->pk, weight_scaler, weight, rand_st);
 
-        //Get F_1(u)
-        F((unsigned char*)sk.k_1.c_str(), sk.k_1.size(), (unsigned char*)v.second.name.c_str(), v.second.name.length(), F_1_u);
+        const unsigned char *F_1_v = labels.F_1.data() + (size_t)dest * KEY_SIZE;
+        const unsigned char *P_v = labels.P.data() + (size_t)dest * KEY_SIZE;
 
-        //Get F_2(u)
-        F((unsigned char*)sk.k_2.c_str(), sk.k_2.size(), (unsigned char*)v.second.name.c_str(), v.second.name.length(), F_2_u);
+        //UT_i and the mask part to blind data.
+        unsigned char *UT_i = tokens.data() + i * EDGE_TOKEN_SIZE;
+        unsigned char *mask = UT_i + KEY_SIZE;
 
-        //Get P(u)
-        F((unsigned char*)sk.k_3.c_str(), sk.k_3.size(),  (unsigned char*)v.second.name.c_str(), v.second.name.length(), P_u);
+        // Blind P(v) || F_1(v) || weight straight into the D_e record.
+        mask_edge_record(P_v, F_1_v, weight.get_mpz_t(), mask, shard.D_e[string((char*)UT_i, KEY_SIZE)]);
+        i++;
+    }
 
-        this->D_cv[v.second.name] = V_ITEM{ctr, string((char*)F_2_u, KEY_SIZE)};
-        this->D_pv[string((char*)P_u, KEY_SIZE)] = V_ITEM{ctr, string((char*)F_2_u, KEY_SIZE)};
-        this->D_v2p[v.second.name] = string((char*)P_u, KEY_SIZE);
+    ggm_free_keys(&sub_keys);
 
-        // The following operations should be done under the condition 
-        // that current vertex out degree is not 0, so we have to check v's out degree.
-        if (ctr == 0)
+    ggm_free_constrain(&constrain);
+}
+
+vector<ENC_SHARD> Client::enc_vertices(const CSRGraph<size_t> &graph, const vector<uint32_t> &todo, size_t base, ThreadPool &pool)
+{
+    vector<ENC_SHARD> shards(pool.size());
+    vector<char> seeded(pool.size(), 0);
+    vector<__gmp_randstate_struct> rand_sts(pool.size());
+
+    // Every vertex is labelled once here instead of once per edge end.
+    VERTEX_LABELS labels;
+    this->label_vertices(graph, pool, labels);
+
+    // Small chunks keep the workers balanced, degrees are very skewed on
+    // the SNAP graphs.
+    pool.parallel_for(todo.size(), 64, [&](size_t begin, size_t end, int slot) {
+        if (!seeded[slot])
+        {
+            gmp_randinit_default(&rand_sts[slot]);
+            seed_rand_state(&rand_sts[slot]);
+            seeded[slot] = 1;
+        }
+        for (size_t i = begin; i < end; i++)
         {
-            continue;
+            this->enc_vertex(graph, labels, todo[i], base, &rand_sts[slot], shards[slot]);
         }
+    });
 
-        // In here all of constrained keys have been generated, a little different
-        // from the design in the paper.
-        // Namely for each QT_i has got and been stored in sub_keys.
-        GGM ggm;
-        ggm.key_size = KEY_SIZE;
-        ggm.n = MAX_GGM_DEPTH;
+    for (size_t slot = 0; slot < seeded.size(); slot++)
+    {
+        if (seeded[slot]) { gmp_randclear(&rand_sts[slot]); }
+    }
 
-        Constrain constrain;
+    return shards;
+}
 
+void Client::merge_shard(ENC_SHARD &shard)
+{
+    this->D_e.insert(shard.D_e.begin(), shard.D_e.end());
+    // Later shards win, enc_graph_stream relies on it to replace the
+    // placeholder of a vertex that was first seen as a destination.
+    for (auto &each : shard.D_pv) { this->D_pv[each.first] = each.second; }
+    for (auto &each : shard.D_cv) { this->D_cv[each.first] = each.second; }
+    this->D_v2p.insert(shard.D_v2p.begin(), shard.D_v2p.end());
+    shard = ENC_SHARD();
+}
 
-        ggm_find_best_range_cover(&ggm, (char*)F_2_u, 0, ctr - 1, &constrain);
+void Client::enc_graph(const string &file_path, int scaler, int threads)
+{
+    build_graph(this->graph, file_path, threads);
 
-        Subkeys sub_keys;
+    size_t base = 1 << scaler;
 
-        ggm_derive(&ggm, &constrain, &sub_keys);
+    // Workers read the edges from contiguous arrays rather than the maps.
+    CSRGraph<size_t> csr;
+    csr.assign(this->graph);
 
-        int i = 0;
-        // if (v.first == "2")
-        // {
-        //     cout << sub_keys.num << endl;
-        //     print_constrain(&constrain, &ggm);
-        // }
-        for (auto e : this->graph.adjacency_list[v.second])
-        {
-            //Firstly, encrypt the weight of the each edge of the vertex v.
-            E_ITEM data_tmp;
+    vector<uint32_t> todo(csr.num_vertices());
+    for (uint32_t v = 0; v < todo.size(); v++)
+    {
+        todo[v] = v;
+    }
 
-            size_t weight_scaler = (size_t)(float(e.weight) * float(base));
+    ThreadPool pool(threads);
+    auto shards = this->enc_vertices(csr, todo, base, pool);
 
-            JL_encryption(this->pk, weight_scaler, data_tmp.weight);
+    this->D_e.reserve(this->D_e.size() + this->graph.num_edges);
+    this->D_pv.reserve(this->D_pv.size() + todo.size());
+    this->D_cv.reserve(this->D_cv.size() + todo.size());
+    this->D_v2p.reserve(this->D_v2p.size() + todo.size());
+    for (auto &shard : shards)
+    {
+        this->merge_shard(shard);
+    }
+}
 
-            unsigned char F_1_v[KEY_SIZE];
-            unsigned char P_v[KEY_SIZE];
 
-            //Get F_1(v)
-            F((unsigned char*)sk.k_1.data(), sk.k_1.size(), (unsigned char*)e.dest.name.c_str(), e.dest.name.length(), F_1_v);
+/**
+ * Encrypt the 2-hop labels of graph for the label engine of the server.
+ * A label (h, d) of v becomes Enc(d) tagged with a keyed token of P_h, so
+ * the server can match the hubs of out(s) and in(t) without learning them.
+ * The labels are of the graph as it is now, updates are not reflected.
+*/
+bool Client::enc_hub_labels(int scaler, int threads)
+{
+    CSRGraph<size_t> csr;
+    csr.assign(this->graph);
+    csr.build_reverse();
 
-            //Get P(v)
-            F((unsigned char*)sk.k_3.data(), sk.k_1.size(), (unsigned char*)e.dest.name.c_str(), e.dest.name.length(), P_v);
-            
-            data_tmp.master_key = string((char*)F_1_v, KEY_SIZE);
-            data_tmp.index = string((char*)P_v, KEY_SIZE);
+    HUB_LABELS labels;
+    if (!build_hub_labels(csr, labels))
+    {
+        return false;
+    }
 
-            unsigned char UT_i[KEY_SIZE] = {0};
-            unsigned char mask[KEY_SIZE] = {0};
+    size_t base = 1 << scaler;
+    size_t n = csr.num_vertices();
+    ThreadPool pool(threads);
+
+    VERTEX_LABELS keys;
+    this->label_vertices(csr, pool, keys);
+
+    // Tag of every hub by rank, keyed by k_2 rather than F, so that it is
+    // unrelated to P_h the server sees in the edge records.
+    EDGE_TOKEN_CTX tag_ctx;
+    edge_token_init(tag_ctx, (const unsigned char*)this->sk.k_2.data(), KEY_SIZE);
+    vector<unsigned char> tags(n * KEY_SIZE);
+    pool.parallel_for(n, 1024, [&](size_t begin, size_t end, int) {
+        unsigned char token[EDGE_TOKEN_SIZE];
+        for (size_t r = begin; r < end; r++)
+        {
+            edge_token(tag_ctx, keys.P.data() + (size_t)labels.order[r] * KEY_SIZE, KEY_SIZE, token);
+            memcpy(tags.data() + r * KEY_SIZE, token, KEY_SIZE);
+        }
+    });
 
-            // if (v.first == "2")
-            // {
-            //     for (int idx = 0 ; idx < KEY_SIZE; idx ++)
-            //         printf("%2hhx ", sub_keys.keys[i][idx]);
-            //     printf("\n");
-            // }
+    vector<unordered_map<string, string>> shards(pool.size());
+    vector<char> seeded(pool.size(), 0);
+    vector<__gmp_randstate_struct> rand_sts(pool.size());
 
-            //Get UT_i
-            H_1(F_1_u, KEY_SIZE, (unsigned char*)sub_keys.keys[i], KEY_SIZE, UT_i);
+    // The field F_1_v of the records is not used. It gets fresh random
+    // bytes, the same mask over a constant would give the mask away.
+    pool.parallel_for(n, 64, [&](size_t begin, size_t end, int slot) {
+        if (!seeded[slot])
+        {
+            gmp_randinit_default(&rand_sts[slot]);
+            seed_rand_state(&rand_sts[slot]);
+            seeded[slot] = 1;
+        }
+        unsigned char token[EDGE_TOKEN_SIZE];
+        unsigned char filler[KEY_SIZE];
+        mpz_class dist;
+        for (size_t v = begin; v < end; v++)
+        {
+            EDGE_TOKEN_CTX ctx;
+            edge_token_init(ctx, keys.F_1.data() + v * KEY_SIZE, KEY_SIZE);
+
+            auto enc_list = [&](const vector<HUB_LABEL> &list, char dir) {
+                for (uint32_t i = 0; i < list.size(); i++)
+                {
+                    label_token(ctx, dir, i, token);
+                    JL_encryption(this->pk, list[i].dist * base, dist, &rand_sts[slot]);
+                    for (int b = 0; b < KEY_SIZE; b++)
+                    {
+                        filler[b] = (unsigned char)gmp_urandomb_ui(&rand_sts[slot], 8);
+                    }
+                    mask_edge_record(tags.data() + (size_t)list[i].hub * KEY_SIZE, filler, dist.get_mpz_t(),
+                                     token + KEY_SIZE, shards[slot][string((char*)token, KEY_SIZE)]);
+                }
+            };
+            enc_list(labels.out[v], HUB_LABEL_OUT);
+            enc_list(labels.in[v], HUB_LABEL_IN);
+        }
+    });
 
-            //Get the mask part to blind data.
-            H_2(F_1_u, KEY_SIZE, (unsigned char *)sub_keys.keys[i], KEY_SIZE, mask);
+    for (size_t slot = 0; slot < seeded.size(); slot++)
+    {
+        if (seeded[slot]) { gmp_randclear(&rand_sts[slot]); }
+        this->D_l.insert(shards[slot].begin(), shards[slot].end());
+    }
+    return true;
+}
 
-            // Now use H_2(F_1(u), QT_i) to mask data.
-            string weight_str = let_mpz_raw_to_str(data_tmp.weight.get_mpz_t());
-            
-            unsigned char data[KEY_SIZE * 2 + weight_str.size()] = {0};
+/**
+ * Encrypt the landmark potentials of graph for A* on the server. For
+ * landmark j, vertex v gets Enc(cap - d(L_j, v)) under 'f' and
+ * Enc(d(v, L_j)) under 't', distances capped at the largest finite one.
+ * Ordering by xi(v) plus either is the ALT lower bound to any target, up
+ * to a constant of the target.
+*/
+bool Client::enc_landmarks(size_t num, int scaler, int threads)
+{
+    CSRGraph<size_t> csr;
+    csr.assign(this->graph);
+    csr.build_reverse();
 
-            std::copy(P_v, P_v + KEY_SIZE, data);
-            std::copy(F_1_v, F_1_v + KEY_SIZE, data + KEY_SIZE);
-            std::copy(weight_str.begin(), weight_str.end(), data + 2 * KEY_SIZE);
+    LANDMARKS landmarks;
+    if (!select_landmarks(csr, num, landmarks))
+    {
+        return false;
+    }
+    size_t cap = landmark_cap(landmarks);
 
-            unsigned char data_masked[KEY_SIZE * 2 + weight_str.size()] = {0};
+    size_t base = 1 << scaler;
+    size_t n = csr.num_vertices();
+    ThreadPool pool(threads);
+
+    VERTEX_LABELS keys;
+    this->label_vertices(csr, pool, keys);
 
-            masking(data, sizeof(data), mask, sizeof(mask), data_masked);
+    vector<unordered_map<string, string>> shards(pool.size());
+    vector<char> seeded(pool.size(), 0);
+    vector<__gmp_randstate_struct> rand_sts(pool.size());
 
-            //remember! the size is important!
-            this->D_e[string((char*)UT_i, sizeof(UT_i))] = string((char*)data_masked, sizeof(data_masked));
-            i++;
+    pool.parallel_for(n, 64, [&](size_t begin, size_t end, int slot) {
+        if (!seeded[slot])
+        {
+            gmp_randinit_default(&rand_sts[slot]);
+            seed_rand_state(&rand_sts[slot]);
+            seeded[slot] = 1;
         }
+        unsigned char token[EDGE_TOKEN_SIZE];
+        mpz_class pot;
+        for (size_t v = begin; v < end; v++)
+        {
+            EDGE_TOKEN_CTX ctx;
+            edge_token_init(ctx, keys.F_1.data() + v * KEY_SIZE, KEY_SIZE);
+
+            auto enc_pot = [&](char dir, uint32_t j, size_t value) {
+                label_token(ctx, dir, j, token);
+                JL_encryption(this->pk, value * base, pot, &rand_sts[slot]);
+                string &record = shards[slot][string((char*)token, KEY_SIZE)];
+                record.resize(mpz_sizeinbase(pot.get_mpz_t(), 256));
+                get_mpz_raw(&record[0], pot.get_mpz_t());
+                masking(record.data(), record.size(), token + KEY_SIZE, KEY_SIZE, (unsigned char*)&record[0]);
+            };
+            for (uint32_t j = 0; j < landmarks.vertices.size(); j++)
+            {
+                enc_pot(LANDMARK_FROM, j, cap - min(landmarks.from[j][v], cap));
+                enc_pot(LANDMARK_TO, j, min(landmarks.to[j][v], cap));
+            }
+        }
+    });
 
-        ggm_free_keys(&sub_keys);
+    for (size_t slot = 0; slot < seeded.size(); slot++)
+    {
+        if (seeded[slot]) { gmp_randclear(&rand_sts[slot]); }
+        this->D_a.insert(shards[slot].begin(), shards[slot].end());
+    }
+    return true;
+}
+
+/**
+ * Encrypt the contraction hierarchy of graph for the upward search of the
+ * server. Edge i of the up (down) list of v, shortcuts included, is an edge
+ * record under label_token(F_1(v), 'u' ('d'), i), keyed by F_1 instead of
+ * the GGM sub keys so the server walks the hierarchy without the proxy.
+ *
+ * Leakage: unlike the other edges of D_e these records are not gated by
+ * a constrained key or a counter. Each one carries F_1 of its neighbour,
+ * so a server that ever saw F_1 of one vertex, which every query hands
+ * over for s and t, can unlock the up and down lists of everything above
+ * it, at any time and without the proxy. Only the weights stay encrypted.
+ * Keep --shortcuts off when the structure of the graph is sensitive.
+*/
+bool Client::enc_shortcuts(int scaler, int threads, unordered_map<string, string>* out)
+{
+    CSRGraph<size_t> csr;
+    csr.assign(this->graph);
+    csr.build_reverse();
 
-        ggm_free_constrain(&constrain);
+    CH_GRAPH ch;
+    if (!build_contraction_hierarchy(csr, ch))
+    {
+        return false;
     }
+
+    size_t base = 1 << scaler;
+    size_t n = csr.num_vertices();
+    ThreadPool pool(threads);
+
+    VERTEX_LABELS keys;
+    this->label_vertices(csr, pool, keys);
+
+    vector<unordered_map<string, string>> shards(pool.size());
+    vector<char> seeded(pool.size(), 0);
+    vector<__gmp_randstate_struct> rand_sts(pool.size());
+
+    pool.parallel_for(n, 64, [&](size_t begin, size_t end, int slot) {
+        if (!seeded[slot])
+        {
+            gmp_randinit_default(&rand_sts[slot]);
+            seed_rand_state(&rand_sts[slot]);
+            seeded[slot] = 1;
+        }
+        unsigned char token[EDGE_TOKEN_SIZE];
+        mpz_class weight;
+        for (size_t v = begin; v < end; v++)
+        {
+            EDGE_TOKEN_CTX ctx;
+            edge_token_init(ctx, keys.F_1.data() + v * KEY_SIZE, KEY_SIZE);
+
+            auto enc_list = [&](const vector<CH_EDGE> &list, char dir) {
+                for (uint32_t i = 0; i < list.size(); i++)
+                {
+                    label_token(ctx, dir, i, token);
+                    JL_encryption(this->pk, list[i].weight * base, weight, &rand_sts[slot]);
+                    mask_edge_record(keys.P.data() + (size_t)list[i].v * KEY_SIZE, keys.F_1.data() + (size_t)list[i].v * KEY_SIZE,
+                                     weight.get_mpz_t(), token + KEY_SIZE, shards[slot][string((char*)token, KEY_SIZE)]);
+                }
+            };
+            enc_list(ch.up[v], CH_UP);
+            enc_list(ch.down[v], CH_DOWN);
+        }
+    });
+
+    unordered_map<string, string> &D_e = (out != nullptr) ? *out : this->D_e;
+    for (size_t slot = 0; slot < seeded.size(); slot++)
+    {
+        if (seeded[slot]) { gmp_randclear(&rand_sts[slot]); }
+        D_e.insert(shards[slot].begin(), shards[slot].end());
+    }
+    return true;
 }
 
+/**
+ * Encrypt a graph that does not fit in memory.
+ * The edge list has to be sorted by source vertex. Edges are read in chunks
+ * of about chunk_edges, and once the out edges of a vertex are complete they
+ * are encrypted and appended to the D_e shards under outdir. Only D_pv, D_cv
+ * and D_v2p, which hold one entry per vertex, are kept in memory.
+*/
+bool Client::enc_graph_stream(const string &file_path, const string &outdir, int scaler, int threads,
+                              size_t chunk_edges, int shard_num)
+{
+    ifstream in_file(file_path, std::ifstream::in);
+    if (in_file.fail())
+    {
+        cerr << "Read graph file failed!" << endl;
+        return false;
+    }
+
+    size_t base = 1 << scaler;
+    ThreadPool pool(threads);
+    DeShardWriter writer(boost::filesystem::path(outdir), shard_num);
+
+    // Edges of the vertices whose out edges are complete.
+    Graph<size_t> chunk;
+    string cur_src;
+    size_t buffered = 0;
+
+    auto flush = [&]() {
+        CSRGraph<size_t> csr;
+        csr.assign(chunk);
+
+        vector<uint32_t> todo;
+        for (uint32_t v = 0; v < csr.num_vertices(); v++)
+        {
+            // Destinations get a placeholder with ctr 0 unless they are known,
+            // the real entry replaces it once their own out edges are read.
+            if (csr.out_degree(v) > 0 || this->D_cv.find(csr.names[v]) == this->D_cv.end())
+            {
+                todo.push_back(v);
+            }
+        }
+        auto shards = this->enc_vertices(csr, todo, base, pool);
+        for (auto &shard : shards)
+        {
+            writer.append(shard.D_e);
+            shard.D_e.clear();
+            this->merge_shard(shard);
+        }
+        chunk.clear();
+        buffered = 0;
+    };
+
+    string line;
+    while (std::getline(in_file, line))
+    {
+        vector<string> strs;
+
+        boost::split(strs, line, boost::is_any_of(" "));
+        if (strs.size() < 3) { continue; }
 
+        if (strs[0] != cur_src)
+        {
+            auto seen = this->D_cv.find(strs[0]);
+            auto in_chunk = chunk.vertices.find(strs[0]);
+            if ((seen != this->D_cv.end() && seen->second.ctr > 0) ||
+                (in_chunk != chunk.vertices.end() && in_chunk->second.out_degree > 0))
+            {
+                cerr << "Edge list is not sorted by source vertex: " << strs[0] << endl;
+                return false;
+            }
+            // Every vertex in chunk is complete now, so it is safe to flush.
+            if (buffered >= chunk_edges)
+            {
+                flush();
+            }
+            cur_src = strs[0];
+        }
+
+        size_t weight = (size_t)std::stoi(strs[2]);
+        chunk.add_edge(strs[0], strs[1], weight);
+        buffered++;
+    }
+    in_file.close();
+
+    flush();
+    writer.close();
+
+    return true;
+}
 
-Client::Client() : graph(), D_pv(), D_e(), D_cv(), D_v2p()
+Client::Client() : graph(), D_pv(), D_e(), D_cv(), D_v2p(), D_l(), D_a()
 {
     sample_key(this->sk, this->pk);
 }
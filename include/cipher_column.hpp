@@ -0,0 +1,78 @@
+#ifndef SEC_GDB_H_CIPHER_COLUMN
+#define SEC_GDB_H_CIPHER_COLUMN
+
+#include <vector>
+#include <gmpxx.h>
+
+#include "crypto_stuff.hpp"
+
+// Limbs of one ciphertext, every ciphertext is reduced mod N. bhjl_gen picks
+// primes of up to JL_MODULUS / 2 + 1 bits, so N may be a bit over JL_MODULUS.
+#define CIPHER_LIMBS (JL_MODULUS / GMP_NUMB_BITS + 1)
+static_assert(CIPHER_LIMBS * GMP_NUMB_BITS >= JL_MODULUS + 1, "A column slot has to hold a N of JL_MODULUS + 1 bits");
+
+/**
+ * An array of JL ciphertexts stored back to back, CIPHER_LIMBS limbs each.
+ * It replaces vector<mpz_class> where ciphertexts are updated over and over
+ * (edge weights, page rank values), the homomorphic operations work on the
+ * limbs in place without allocating.
+ * Without encryption a slot holds a plaintext in two's complement.
+*/
+class CipherColumn
+{
+  private:
+    std::vector<mp_limb_t> limbs;
+
+  public:
+    // Lets column[i] be read as and assigned from a mpz_class.
+    class Ref
+    {
+      private:
+        CipherColumn &col;
+        size_t idx;
+
+      public:
+        Ref(CipherColumn &col, size_t idx) : col(col), idx(idx) {}
+
+        inline operator mpz_class() const { return col.get(idx); }
+        inline Ref &operator=(const mpz_class &value) { col.set(idx, value); return *this; }
+        inline Ref &operator=(const Ref &other) { col.set(idx, other.col, other.idx); return *this; }
+    };
+
+    explicit CipherColumn(size_t n = 0);
+
+    inline size_t size() const { return this->limbs.size() / CIPHER_LIMBS; }
+    inline void resize(size_t n) { this->limbs.resize(n * CIPHER_LIMBS, 0); }
+    inline void clear() { this->limbs.clear(); }
+
+    inline mp_limb_t *data(size_t i) { return &this->limbs[i * CIPHER_LIMBS]; }
+    inline const mp_limb_t *data(size_t i) const { return &this->limbs[i * CIPHER_LIMBS]; }
+
+    inline Ref operator[](size_t i) { return Ref(*this, i); }
+    inline mpz_class operator[](size_t i) const { return this->get(i); }
+
+    void assign(const std::vector<mpz_class> &values);
+
+    void get(size_t i, mpz_class &out) const;
+    mpz_class get(size_t i) const;
+
+    void set(size_t i, const mpz_class &value);
+    void set(size_t i, const CipherColumn &other, size_t j);
+
+    // Slot i becomes slot i (+) right.
+    void homo_add(const JL_PK &jl_pk, size_t i, const mpz_class &right);
+    void homo_add(const JL_PK &jl_pk, size_t i, const CipherColumn &other, size_t j);
+
+    // Slot i becomes slot i (-) right.
+    void homo_sub(const JL_PK &jl_pk, size_t i, const mpz_class &right);
+    void homo_sub(const JL_PK &jl_pk, size_t i, const CipherColumn &other, size_t j);
+
+    // Slot i becomes scalar (*) slot i.
+    void homo_mul(const JL_PK &jl_pk, size_t i, const mpz_class &scalar);
+
+    // Homomorphic sum of the slots in [begin, end) into out, which has to
+    // hold an encryption of zero or a value to add to.
+    void homo_sum(const JL_PK &jl_pk, size_t begin, size_t end, mpz_class &out) const;
+};
+
+#endif // SEC_GDB_H_CIPHER_COLUMN
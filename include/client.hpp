@@ -5,12 +5,34 @@
 #include <gmpxx.h>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "global.h"
 #include "graph.hpp"
 #include "data_structures.hpp"
 #include "crypto_stuff.hpp"
 #include "io.hpp"
+#include "thread_pool.hpp"
+
+// Part of the encrypted graph produced by one worker of enc_graph.
+// Each worker only touches its own shard, the shards are merged once
+// every vertex is done.
+typedef struct _ENC_SHARD
+{
+    std::unordered_map<std::string, std::string> D_e;
+    std::unordered_map<std::string, V_ITEM> D_pv;
+    std::unordered_map<std::string, V_ITEM> D_cv;
+    std::unordered_map<std::string, std::string> D_v2p;
+} ENC_SHARD;
+
+// F_1, F_2 and P of every vertex of a CSR graph, KEY_SIZE bytes each,
+// indexed by vertex id.
+typedef struct _VERTEX_LABELS
+{
+    std::vector<unsigned char> F_1;
+    std::vector<unsigned char> F_2;
+    std::vector<unsigned char> P;
+} VERTEX_LABELS;
 
 class Client
 {
@@ -38,14 +60,49 @@ class Client
     // Mapping v name to P_v
     std::unordered_map<std::string, std::string> D_v2p;
 
+    // D_l, the 2-hop labels of the graph for the server. Entry i of the out
+    // (in) list of v is under label_token(F_1(v), 'o' ('i'), i), the record
+    // is an edge record with the hub tag for P_v, random bytes for F_1_v and
+    // the distance as weight.
+    std::unordered_map<std::string, std::string> D_l;
+
+    // D_a, encrypted potentials of the landmarks for A* on the server.
+    // Entry j of v is under label_token(F_1(v), 'f' or 't', j), the record
+    // is the masked ciphertext.
+    std::unordered_map<std::string, std::string> D_a;
+
+    // Derive the labels of all vertices of graph with F_batch on the pool.
+    void label_vertices(const CSRGraph<size_t> &graph, ThreadPool &pool, VERTEX_LABELS &labels);
+
+    // Encrypt one vertex of graph and its out edges into the shard.
+    void enc_vertex(const CSRGraph<size_t> &graph, const VERTEX_LABELS &labels, uint32_t v, size_t base,
+                    gmp_randstate_t rand_st, ENC_SHARD &shard);
+
+    // Encrypt the given vertices on the pool, returns one shard per slot.
+    std::vector<ENC_SHARD> enc_vertices(const CSRGraph<size_t> &graph, const std::vector<uint32_t> &todo, size_t base, ThreadPool &pool);
+
+    // Move a shard into D_e, D_pv, D_cv and D_v2p.
+    void merge_shard(ENC_SHARD &shard);
+
   public:
     Client();
     ~Client();
 
     void keygen();
-    void enc_graph(const std::string &file_path, int scaler=0);
+    void enc_graph(const std::string &file_path, int scaler=0, int threads=1);
+    bool enc_graph_stream(const std::string &file_path, const std::string &outdir, int scaler=0, int threads=1,
+                          size_t chunk_edges=(1 << 20), int shard_num=16);
+    // Build the hub labels of graph and encrypt them into D_l.
+    bool enc_hub_labels(int scaler=0, int threads=1);
+    // Pick num landmarks of graph and encrypt their potentials into D_a.
+    bool enc_landmarks(size_t num, int scaler=0, int threads=1);
+    // Contract graph and add its upward and downward edges to D_e, only
+    // those are returned when out is given. The records are keyed by F_1
+    // and not gated, see the leakage note in client.cpp.
+    bool enc_shortcuts(int scaler=0, int threads=1, std::unordered_map<std::string, std::string>* out=nullptr);
     Request give_request(std::string src, std::string dest);
-    void update_graph(const std::string &src, const std::string &dest, const size_t weight, int op);
+    // update gets what the server has to apply, see Server::apply_update.
+    void update_graph(const std::string &src, const std::string &dest, const size_t weight, int op, U_ITEM *update=nullptr);
 
     void store_sk(const std::string& filePath) const { if (!save_sk(filePath, this->sk)) { std::cerr << "Saving sk failed." << std::endl; } };
     void read_sk(const std::string& filePath) { if (!load_sk(filePath, this->sk)) { std::cerr << "Loading sk failed." << std::endl; } };
@@ -58,6 +115,10 @@ class Client
     void load_dcv(const std::string &filePath);
     void save_de(const std::string &filePath);
     void load_de(const std::string &filePath);
+    void save_dl(const std::string &filePath);
+    bool load_dl(const std::string &filePath);
+    void save_da(const std::string &filePath);
+    bool load_da(const std::string &filePath);
 
     inline void clean_up()
     {
@@ -65,6 +126,8 @@ class Client
       this->D_cv.clear();
       this->D_pv.clear();
       this->D_e.clear();
+      this->D_l.clear();
+      this->D_a.clear();
     }
 
     inline void set_keys(const PK& pk, const SK& sk)
@@ -74,7 +137,7 @@ class Client
     }
 
     inline Graph<size_t>& get_graph() { return this->graph; }
-    inline void set_graph(const std::string& path) { build_graph(this->graph, path); }
+    inline void set_graph(const std::string& path, int threads = 1) { build_graph(this->graph, path, threads); }
 
     inline SK& get_sk() { return this->sk; }
 
@@ -82,6 +145,10 @@ class Client
 
     inline const std::unordered_map<std::string, std::string> &get_De() const { return this->D_e; }
 
+    inline const std::unordered_map<std::string, std::string> &get_Dl() const { return this->D_l; }
+
+    inline const std::unordered_map<std::string, std::string> &get_Da() const { return this->D_a; }
+
     inline void set_De(std::unordered_map<std::string, std::string> &&D_e) { this->D_e = std::forward<std::unordered_map<std::string, std::string>>(D_e); }
 
     inline const std::unordered_map<std::string, V_ITEM> &get_Dpv() const { return this->D_pv; }
@@ -90,7 +157,7 @@ class Client
     
     inline const std::unordered_map<std::string, V_ITEM> &get_Dcv() const { return this->D_cv; }
 
-    inline void set_Dcv(std::unordered_map<std::string, V_ITEM> &&Dcv) { this->D_cv = std::forward<std::unordered_map<std::string, V_ITEM>>(D_cv); }
+    inline void set_Dcv(std::unordered_map<std::string, V_ITEM> &&D_cv) { this->D_cv = std::forward<std::unordered_map<std::string, V_ITEM>>(D_cv); }
 
     inline const std::unordered_map<std::string, std::string> &get_Dv2p() const { return this->D_v2p; }
 };
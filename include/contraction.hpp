@@ -0,0 +1,40 @@
+#ifndef SEC_GDB_H_CONTRACTION
+#define SEC_GDB_H_CONTRACTION
+
+#include <vector>
+#include <cstdint>
+
+#include "graph.hpp"
+
+// Returned by ch_distance when t can not be reached from s.
+const size_t CH_NO_PATH = (size_t)-1;
+
+typedef struct _CH_EDGE
+{
+    uint32_t v;
+    size_t weight;
+} CH_EDGE;
+
+/**
+ * Contraction hierarchy of a directed graph, original edges and shortcuts
+ * split by the rank of their ends. up[u] holds the edges u -> v with
+ * rank[v] > rank[u], down[v] the edges u -> v with rank[u] > rank[v],
+ * stored at v as {u, weight} for the backward search. A shortest path
+ * from s to t goes up from s and down to t, so searching up[] from s and
+ * down[] from t meets on it.
+*/
+typedef struct _CH_GRAPH
+{
+    std::vector<uint32_t> rank;
+    std::vector<std::vector<CH_EDGE>> up;
+    std::vector<std::vector<CH_EDGE>> down;
+    size_t num_shortcuts;
+} CH_GRAPH;
+
+// Contract the vertices of graph by edge difference, the one leaving the
+// fewest shortcuts first. graph needs its reverse CSR.
+bool build_contraction_hierarchy(const CSRGraph<size_t> &graph, CH_GRAPH &ch);
+
+size_t ch_distance(const CH_GRAPH &ch, uint32_t s, uint32_t t);
+
+#endif // SEC_GDB_H_CONTRACTION
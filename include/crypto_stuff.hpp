@@ -2,7 +2,11 @@
 #define SEC_GDB_H_CRYPTO
 
 #include <iostream>
+#include <cstdint>
 #include <gmpxx.h>
+#include <openssl/sha.h>
+
+#include "global.h"
 
 #ifdef SECURITY_LEVEL_128
 #define JL_MODULUS 1024
@@ -26,12 +30,39 @@ typedef struct _JL_PK
     mpz_class _2k;
 } JL_PK;
 
+#ifdef SEC_GDB_AES_PRF
+#ifdef SECURITY_LEVEL_128
+#define AES_PRF_ROUNDS 10
+#else
+#define AES_PRF_ROUNDS 14
+#endif
+#endif
+
+/**
+ * A key of F, expanded once when the SK is sampled or loaded.
+ * With SEC_GDB_AES_PRF it holds the AES round keys, otherwise the raw key
+ * which is handed to HMAC (or ignored with F_FUNCTION_DISABLE).
+*/
+typedef struct _PRF_KEY
+{
+#ifdef SEC_GDB_AES_PRF
+    unsigned char rk[(AES_PRF_ROUNDS + 1) * 16];
+#else
+    std::string key;
+#endif
+} PRF_KEY;
+
 typedef struct _SK
 {
     std::string k_1;
     std::string k_2;
     std::string k_3;
     JL_SK jl_sk;
+
+    // k_1, k_2 and k_3 ready to use by F, see sk_expand.
+    PRF_KEY f_1;
+    PRF_KEY f_2;
+    PRF_KEY f_3;
 } SK;
 
 typedef struct _PK
@@ -39,6 +70,38 @@ typedef struct _PK
     JL_PK jl_pk;
 } PK;
 
+// Output of edge_token, UT_i followed by the mask.
+#define EDGE_TOKEN_SIZE (2 * KEY_SIZE)
+
+// Lists kept per vertex, see label_token. Hub labels, the distances from
+// and to the landmarks and the edges of the contraction hierarchy.
+#define HUB_LABEL_OUT 'o'
+#define HUB_LABEL_IN 'i'
+#define LANDMARK_FROM 'f'
+#define LANDMARK_TO 't'
+#define CH_UP 'u'
+#define CH_DOWN 'd'
+
+/**
+ * Token state keyed by F_1(u), shared by all out edges of u.
+ * By default it is the HMAC state, whose digest is exactly EDGE_TOKEN_SIZE
+ * bytes long. With SEC_GDB_KECCAK_TOKEN the tokens come from a TurboSHAKE
+ * style sponge and only the key is kept, it is absorbed with the sub key.
+*/
+typedef struct _EDGE_TOKEN_CTX
+{
+#if defined SEC_GDB_KECCAK_TOKEN
+    unsigned char key[KEY_SIZE];
+    size_t key_size;
+#elif defined SECURITY_LEVEL_128
+    SHA256_CTX inner;
+    SHA256_CTX outer;
+#else
+    SHA512_CTX inner;
+    SHA512_CTX outer;
+#endif
+} EDGE_TOKEN_CTX;
+
 /******************** Functions ********************/
 size_t get_mpz_raw(void* buff, mpz_ptr src);
 
@@ -46,26 +109,20 @@ std::string let_mpz_raw_to_str(mpz_ptr src);
 
 void set_mpz_raw(mpz_ptr dest, size_t size, const void* buff);
 
-void H_1(
+size_t F(
     unsigned char *key,
     size_t key_size,
     unsigned char *in,
     size_t data_size,
     unsigned char *out);
 
-void H_2(
-    unsigned char *key,
-    size_t key_size,
-    unsigned char *in,
-    size_t data_size,
-    unsigned char *out);
+size_t F(const PRF_KEY &key, const unsigned char *in, size_t data_size, unsigned char *out);
 
-size_t F(
-    unsigned char *key,
-    size_t key_size,
-    unsigned char *in,
-    size_t data_size,
-    unsigned char *out);
+void F_batch(const PRF_KEY &key, const std::string *in, size_t num, unsigned char *out);
+
+void prf_key_init(PRF_KEY &key, const std::string &k);
+
+void sk_expand(SK &sk);
 
 bool sample_key(SK &sk, PK &pk);
 
@@ -73,8 +130,12 @@ void sk_clear(SK &sk);
 
 void pk_clear(PK &pk);
 
+void seed_rand_state(gmp_randstate_t rand_st);
+
 void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out);
+void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out, gmp_randstate_t rand_st);
 void JL_encryption(PK &pk, size_t num, mpz_class &out);
+void JL_encryption(PK &pk, size_t num, mpz_class &out, gmp_randstate_t rand_st);
 void JL_encryption(PK &pk, mpz_class &in, mpz_class &out);
 
 void JL_decryption(JL_SK &jl_sk, JL_PK &jl_pk, mpz_class &in, mpz_class &out);
@@ -90,7 +151,24 @@ mpz_class JL_homo_sub(const PK &pk, const mpz_class &left, const mpz_class &righ
 mpz_class JL_homo_mul(const JL_PK &jl_pk, const mpz_class &left, const mpz_class &right);
 mpz_class JL_homo_mul(const PK &pk, const mpz_class &left, const mpz_class &right);
 
-void masking(const void* input, size_t size, unsigned char* mask, size_t mask_size, unsigned char* out);
+void edge_token_init(EDGE_TOKEN_CTX &ctx, const unsigned char *F_1_u, size_t key_size);
+
+void edge_token(const EDGE_TOKEN_CTX &ctx, const unsigned char *sub_key, size_t sub_key_size, unsigned char *out);
+
+void edge_tokens(const EDGE_TOKEN_CTX &ctx, char *const *sub_keys, size_t num, size_t sub_key_size, unsigned char *out);
+
+void label_token(const EDGE_TOKEN_CTX &ctx, char dir, uint32_t i, unsigned char *out);
+
+void masking(const void* input, size_t size, const unsigned char* mask, size_t mask_size, unsigned char* out);
+
+void mask_edge_record(const unsigned char* P_v, const unsigned char* F_1_v, mpz_srcptr weight,
+                      const unsigned char* mask, std::string& record);
+
+void unmask_edge_record(const std::string& record, const unsigned char* mask,
+                        unsigned char* P_v, unsigned char* F_1_v, mpz_ptr weight);
+
+bool unmask_edge_record(const std::string& record, const unsigned char* mask,
+                        unsigned char* P_v, unsigned char* F_1_v, mp_limb_t* limbs, size_t num_limbs);
 
 
 #ifdef SEC_GDB_DBG
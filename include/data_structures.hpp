@@ -42,10 +42,21 @@ struct hash<mpz_t>
 };
 } // namespace std
 
+// An edge insertion as the server sees it: the new D_e record of P(u) and
+// the counter of P(u) after it.
+typedef struct _U_ITEM
+{
+    std::string token;      //UT
+    std::string record;
+    std::string index;      //P(u)
+    size_t ctr;
+} U_ITEM;
+
 typedef struct _REQUEST
 {
     std::string F_1_s;
     std::string P_s;
+    std::string F_1_t;
     std::string P_t;
     Constrain constrained_key;
     size_t ctr;
@@ -37,7 +37,10 @@ typedef unsigned char BYTE;
 
 // #define SEC_GDB_WITHOUT_ENCRYPTION
 
+// The AES PRF is only worth building when F is in use.
+#ifndef SEC_GDB_AES_PRF
 #define F_FUNCTION_DISABLE
+#endif
 
 #define MAX_EDGE_WEIGHT 10000
 #define SEC_GDB_INF 1000000
@@ -54,6 +57,8 @@ static void log_dbg(const char* msg)
 {
 #ifdef SEC_GDB_DBG
     fprintf(stderr, "%s", msg);
+#else
+    (void)msg;
 #endif
 }
 
@@ -63,6 +68,8 @@ static void log_dbg_fmt(const char* fmt, ...)
     va_list args;
     va_start(args, fmt);
     vfprintf(stderr, fmt, args);
+#else
+    (void)fmt;
 #endif
 }
 
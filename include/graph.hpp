@@ -7,6 +7,7 @@
 #include <unordered_set>
 #include <list>
 #include <vector>
+#include <cstdint>
 
 struct Vertex
 {
@@ -88,6 +89,86 @@ class Graph
     void clear();
 };
 
-void build_graph(Graph<size_t> &graph, const std::string &file_path);
+// Returned by CSRGraph::id_of for names that are not interned.
+const uint32_t CSR_NO_VERTEX = 0xffffffff;
+
+/**
+ * A graph in compressed sparse row form.
+ * Vertex names are interned into dense ids, the out edges of v are
+ * targets[offsets[v]] .. targets[offsets[v + 1] - 1] with their weights at
+ * the same indexes. The reverse CSR is optional, it lists the in edges of v
+ * as indexes of forward edges, so both directions share one weight.
+*/
+template<class T>
+class CSRGraph
+{
+  public:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> targets;
+    std::vector<T> weights;
+
+    std::vector<size_t> rev_offsets;
+    std::vector<uint32_t> rev_sources;
+    std::vector<size_t> rev_edges;
+
+    // Only set by build_residual, pair[e] is the edge going back along e.
+    std::vector<size_t> pair;
+
+    CSRGraph();
+
+    uint32_t intern(const std::string &name);
+
+    uint32_t id_of(const std::string &name) const;
+
+    inline size_t num_vertices() const { return this->names.size(); }
+    inline size_t num_edges() const { return this->targets.size(); }
+
+    inline size_t out_degree(uint32_t v) const { return this->offsets[v + 1] - this->offsets[v]; }
+    inline size_t in_degree(uint32_t v) const { return this->rev_offsets[v + 1] - this->rev_offsets[v]; }
+
+    // Index of the edge from src to dest, or num_edges() when there is none.
+    size_t find_edge(uint32_t src, uint32_t dest) const;
+
+    void assign(const std::vector<uint32_t> &src, const std::vector<uint32_t> &dest, std::vector<T> &weight);
+
+    void assign(const Graph<T> &graph);
+
+    void build_reverse();
+
+    std::vector<char> build_residual(const T &zero);
+
+    void clear();
+};
+
+/**
+ * An edge list as it is read from a graph file.
+ * Vertices are interned, src and dest hold indexes into names, so an edge
+ * costs 16 bytes and parsing does not allocate per edge.
+*/
+typedef struct _EDGE_LIST
+{
+    std::vector<std::string> names;
+    std::vector<uint32_t> src;
+    std::vector<uint32_t> dest;
+    std::vector<size_t> weight;
+} EDGE_LIST;
+
+bool parse_edge_list(const std::string &file_path, EDGE_LIST &edges, int threads = 1);
+
+// The binary cache of a graph file lives next to it.
+std::string edge_list_cache_path(const std::string &file_path);
+
+// The cache records the size and mtime of file_path, the graph file edges
+// were parsed from, and is only loaded while both still match.
+bool save_edge_list_cache(const std::string &cache_path, const std::string &file_path, const EDGE_LIST &edges);
+
+bool load_edge_list_cache(const std::string &cache_path, const std::string &file_path, EDGE_LIST &edges);
+
+void build_graph(Graph<size_t> &graph, const EDGE_LIST &edges);
+
+void build_graph(Graph<size_t> &graph, const std::string &file_path, int threads = 1);
 
 #endif
\ No newline at end of file
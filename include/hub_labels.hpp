@@ -0,0 +1,36 @@
+#ifndef SEC_GDB_H_HUB_LABELS
+#define SEC_GDB_H_HUB_LABELS
+
+#include <vector>
+#include <cstdint>
+
+#include "graph.hpp"
+
+// Returned by hub_distance when t can not be reached from s.
+const size_t HUB_NO_PATH = (size_t)-1;
+
+typedef struct _HUB_LABEL
+{
+    uint32_t hub;   // Rank of the hub, order[hub] is the vertex.
+    size_t dist;
+} HUB_LABEL;
+
+/**
+ * 2-hop labels of a directed graph built by pruned landmark labeling.
+ * out[v] lists hubs v reaches with d(v, hub), in[v] hubs reaching v with
+ * d(hub, v), both sorted by hub rank. d(s, t) is the smallest
+ * out.dist + in.dist over the hubs out[s] and in[t] have in common.
+*/
+typedef struct _HUB_LABELS
+{
+    std::vector<uint32_t> order;
+    std::vector<std::vector<HUB_LABEL>> out;
+    std::vector<std::vector<HUB_LABEL>> in;
+} HUB_LABELS;
+
+// graph needs its reverse CSR, see CSRGraph::build_reverse.
+bool build_hub_labels(const CSRGraph<size_t> &graph, HUB_LABELS &labels);
+
+size_t hub_distance(const HUB_LABELS &labels, uint32_t s, uint32_t t);
+
+#endif // SEC_GDB_H_HUB_LABELS
@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include <boost/filesystem.hpp>
 #include <string>
+#include <vector>
+#include <fstream>
 #include "data_structures.hpp"
 #include "crypto_stuff.hpp"
 
@@ -31,4 +33,45 @@ bool load_Dv(const std::string& file_path, std::unordered_map<std::string, V_ITE
 bool load_De(const boost::filesystem::path& p, std::unordered_map<std::string, std::string>& D_e);
 bool load_De(const std::string& file_path, std::unordered_map<std::string, std::string>& D_e);
 
+bool load_De_shards(const boost::filesystem::path& dir, std::unordered_map<std::string, std::string>& D_e);
+bool load_De_shards(const std::string& dir_path, std::unordered_map<std::string, std::string>& D_e);
+
+// <dir>/de.<idx>.bin, load_De_shards reads them from 0 up to the count in
+// <dir>/de.count, so shards left over from an earlier run are ignored.
+boost::filesystem::path de_shard_path(const boost::filesystem::path& dir, int idx);
+bool save_De_shard_count(const boost::filesystem::path& dir, int count);
+// -1 if dir has no count, it was written before the count existed.
+int load_De_shard_count(const boost::filesystem::path& dir);
+// Save D_e as one more shard after those counted in dir.
+bool append_De_shard(const boost::filesystem::path& dir, const std::unordered_map<std::string, std::string>& D_e);
+
+/**
+ * Appends D_e records to the shard files <dir>/de.<i>.bin.
+ * Each shard has the same layout as save_De, the record count in the
+ * header is filled in by close(), so every shard can be read by load_De.
+ * close() also writes the shard count.
+*/
+class DeShardWriter
+{
+private:
+    boost::filesystem::path dir;
+    std::vector<std::ofstream> shards;
+    std::vector<size_t> counts;
+
+public:
+    DeShardWriter(const boost::filesystem::path& dir, int shard_num);
+    ~DeShardWriter();
+
+    void append(const std::string& key, const std::string& value);
+    void append(const std::unordered_map<std::string, std::string>& D_e);
+    void close();
+
+    inline size_t size() const
+    {
+        size_t total = 0;
+        for (auto each : counts) { total += each; }
+        return total;
+    }
+};
+
 #endif // SEC_GDB_H_IO
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef SEC_GDB_H_LANDMARKS
+#define SEC_GDB_H_LANDMARKS
+
+#include <vector>
+#include <cstdint>
+
+#include "graph.hpp"
+
+// Distance to or from a landmark that can not be reached.
+const size_t LANDMARK_NO_PATH = (size_t)-1;
+
+/**
+ * Landmarks of a directed graph for ALT lower bounds. from[j][v] is
+ * d(vertices[j], v) and to[j][v] is d(v, vertices[j]). For any s and t,
+ * from[j][t] - from[j][s] and to[j][s] - to[j][t] are at most d(s, t).
+*/
+typedef struct _LANDMARKS
+{
+    std::vector<uint32_t> vertices;
+    std::vector<std::vector<size_t>> from;
+    std::vector<std::vector<size_t>> to;
+} LANDMARKS;
+
+// Pick num landmarks by farthest selection and get their distances.
+// graph needs its reverse CSR, see CSRGraph::build_reverse.
+bool select_landmarks(const CSRGraph<size_t> &graph, size_t num, LANDMARKS &landmarks);
+
+// Largest finite distance to or from any landmark, unreachable vertices
+// are capped to it so that the potentials stay feasible.
+size_t landmark_cap(const LANDMARKS &landmarks);
+
+#endif // SEC_GDB_H_LANDMARKS
@@ -0,0 +1,149 @@
+#ifndef SEC_GDB_H_LRU_CACHE
+#define SEC_GDB_H_LRU_CACHE
+
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+
+/**
+ * A map bounded by bytes rather than entries, the least recently used
+ * entries are dropped once the budget is exceeded. The caller tells how
+ * many bytes each value takes. A capacity of 0 disables the cache.
+ * Counts hits, misses and evictions for the experiment logs.
+*/
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LRUCache
+{
+  private:
+    typedef struct _ENTRY
+    {
+        K key;
+        V value;
+        size_t bytes;
+    } ENTRY;
+
+    // Most recently used first.
+    std::list<ENTRY> entries;
+    std::unordered_map<K, typename std::list<ENTRY>::iterator, Hash> index;
+
+    size_t capacity;
+    size_t used;
+    size_t num_hits;
+    size_t num_misses;
+    size_t num_evictions;
+
+    void evict_to(size_t budget)
+    {
+        while (this->used > budget && !this->entries.empty())
+        {
+            ENTRY &last = this->entries.back();
+            this->used -= last.bytes;
+            this->index.erase(last.key);
+            this->entries.pop_back();
+            this->num_evictions++;
+        }
+    }
+
+  public:
+    explicit LRUCache(size_t capacity = 0)
+        : entries(), index(), capacity(capacity), used(0), num_hits(0), num_misses(0), num_evictions(0)
+    {
+    }
+
+    inline bool enabled() const { return this->capacity > 0; }
+    inline size_t size() const { return this->index.size(); }
+    inline size_t bytes() const { return this->used; }
+    inline size_t get_capacity() const { return this->capacity; }
+    inline size_t hits() const { return this->num_hits; }
+    inline size_t misses() const { return this->num_misses; }
+    inline size_t evictions() const { return this->num_evictions; }
+
+    inline double hit_rate() const
+    {
+        size_t total = this->num_hits + this->num_misses;
+        return total == 0 ? 0.0 : double(this->num_hits) / double(total);
+    }
+
+    void set_capacity(size_t capacity)
+    {
+        this->capacity = capacity;
+        this->evict_to(capacity);
+    }
+
+    // The value of key, now the most recent one, or nullptr.
+    V *get(const K &key)
+    {
+        auto it = this->index.find(key);
+        if (it == this->index.end())
+        {
+            this->num_misses++;
+            return nullptr;
+        }
+        this->num_hits++;
+        this->entries.splice(this->entries.begin(), this->entries, it->second);
+        return &it->second->value;
+    }
+
+    // Look at a value without touching the order or the counters.
+    const V *peek(const K &key) const
+    {
+        auto it = this->index.find(key);
+        return it == this->index.end() ? nullptr : &it->second->value;
+    }
+
+    // Insert or replace key. A value larger than the whole budget is not
+    // kept, nullptr is returned then.
+    V *put(const K &key, V value, size_t bytes)
+    {
+        this->erase(key);
+        if (bytes > this->capacity)
+        {
+            return nullptr;
+        }
+        this->evict_to(this->capacity - bytes);
+        this->entries.push_front(ENTRY{key, std::move(value), bytes});
+        this->index[key] = this->entries.begin();
+        this->used += bytes;
+        return &this->entries.front().value;
+    }
+
+    bool erase(const K &key)
+    {
+        auto it = this->index.find(key);
+        if (it == this->index.end())
+        {
+            return false;
+        }
+        this->used -= it->second->bytes;
+        this->entries.erase(it->second);
+        this->index.erase(it);
+        return true;
+    }
+
+    void clear()
+    {
+        this->entries.clear();
+        this->index.clear();
+        this->used = 0;
+    }
+
+    void reset_stats()
+    {
+        this->num_hits = 0;
+        this->num_misses = 0;
+        this->num_evictions = 0;
+    }
+
+    // Visit entries from the least to the most recently used, so inserting
+    // them in that order into another cache keeps the order.
+    void for_each(const std::function<void(const K &, const V &, size_t)> &visit) const
+    {
+        for (auto it = this->entries.rbegin(); it != this->entries.rend(); ++it)
+        {
+            visit(it->key, it->value, it->bytes);
+        }
+    }
+};
+
+#endif // SEC_GDB_H_LRU_CACHE
@@ -0,0 +1,74 @@
+#ifndef SEC_GDB_H_MASK_POOL
+#define SEC_GDB_H_MASK_POOL
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <gmpxx.h>
+
+/**
+ * Blinding masks and their encryptions made ahead of time. Background
+ * workers keep a queue of depth pairs for each mask size, and every pair is
+ * handed out once. A take on an empty queue makes its pair on the spot, so
+ * the pool only moves work off the critical path and never blocks on it.
+ * Mask sizes seen for the first time get a queue from then on.
+*/
+class MaskPool
+{
+  public:
+    // Draws a mask of the given bits and encrypts it.
+    typedef std::function<void(int, mpz_class&, mpz_class&)> GENERATOR;
+
+  private:
+    typedef struct _QUEUE
+    {
+        std::deque<std::pair<mpz_class, mpz_class>> ready;
+        // Pairs the workers are making right now.
+        size_t pending;
+    } QUEUE;
+
+    GENERATOR gen;
+    size_t depth;
+
+    std::map<int, QUEUE> queues;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mtx;
+    // Workers wait on want for a queue to run low, wait_full on filled.
+    std::condition_variable want;
+    std::condition_variable filled;
+    bool stop;
+
+    size_t num_hits;
+    size_t num_misses;
+
+    // The size of the queue furthest from depth, false when all are full.
+    bool lowest(int &bits) const;
+    bool all_full() const;
+    void worker_loop();
+
+  public:
+    MaskPool(GENERATOR gen, size_t depth, const std::vector<int> &bits, int threads = 1);
+    ~MaskPool();
+
+    MaskPool(const MaskPool&) = delete;
+    MaskPool& operator=(const MaskPool&) = delete;
+
+    // A mask of bits bits and its encryption, never handed out before.
+    void take(int bits, mpz_class &mask, mpz_class &enc);
+
+    // Block until every queue holds depth pairs.
+    void wait_full();
+
+    size_t ready(int bits) const;
+    inline size_t get_depth() const { return this->depth; }
+    // Takes served from a queue and takes that made their pair inline.
+    size_t hits() const;
+    size_t misses() const;
+};
+
+#endif // SEC_GDB_H_MASK_POOL
@@ -6,22 +6,74 @@
 #define COMPARE_LOWER -1
 #define COMPARE_EQUAL 0
 
+// Compares packed into one plaintext by secure_compare_batch at 32 bits,
+// each takes sizeof(OBLIVC_DATA_TYPE) * 8 bits of the JL message space.
+// Other widths fit compare_slots of them into the same space.
+#define MAX_COMPARE_BATCH 4
+
 #include <gmpxx.h>
 #include <boost/asio.hpp>
 #include <vector>
 
 #include "crypto_stuff.hpp"
+#include "mask_pool.hpp"
 
 extern "C"
 {
 #include "obliv.h"
+#include "mpc_compare.h"
 }
 
-void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, boost::asio::ip::tcp::socket& sock);
-int secure_compare(ProtocolDesc& pd, JL_PK& pk, mpz_class& left, mpz_class& right, boost::asio::ip::tcp::socket& sock);
+// The single bit circuit telling whether left mode right holds, mode is
+// one of COMPARE_HIGHER, COMPARE_LOWER and COMPARE_EQUAL.
+int compare_circuit(int mode);
+
+// Draws fresh masks and encrypts them under jl_pk, for a MaskPool.
+MaskPool::GENERATOR mask_generator(const JL_PK& jl_pk);
+// Blinding masks come from pool once set, nullptr makes them on demand
+// again. The pool has to outlive its use.
+void use_mask_pool(MaskPool* pool);
+// A random mask of bits bits and its encryption, bits 0 gives an
+// encryption of zero.
+void blinding_mask(JL_PK& jl_pk, int bits, mpz_class& mask, mpz_class& enc);
+
+// Bits of a SEC_GDB_WIDTH_* circuit.
+int width_bits(int width);
+// The narrowest width whose circuits compare values up to bound in
+// absolute value, the masks take the rest of the bits.
+int compare_width(const mpz_class& bound);
+// Pairs secure_compare_batch packs into one plaintext at width.
+int compare_slots(int width);
+
+// circuit is one of SEC_GDB_COMPARE_* and width one of SEC_GDB_WIDTH_*,
+// the remote side gets them from the protocol head and has to run the
+// same ones.
+void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, boost::asio::ip::tcp::socket& sock,
+                           int circuit=SEC_GDB_COMPARE_3WAY, int width=SEC_GDB_WIDTH_32);
+int secure_compare(ProtocolDesc& pd, JL_PK& pk, mpz_class& left, mpz_class& right, boost::asio::ip::tcp::socket& sock,
+                   int circuit=SEC_GDB_COMPARE_3WAY, int width=SEC_GDB_WIDTH_32);
 
-void secure_compare_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, boost::asio::ip::tcp::socket& sock);
-std::vector<int> secure_compare_batch(JL_PK& jl_pk, std::vector<mpz_class>& left, std::vector<mpz_class>& right, boost::asio::ip::tcp::socket& sock);
+void secure_compare_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, boost::asio::ip::tcp::socket& sock,
+                                 int circuit=SEC_GDB_COMPARE_3WAY, int width=SEC_GDB_WIDTH_32);
+std::vector<int> secure_compare_batch(JL_PK& jl_pk, std::vector<mpz_class>& left, std::vector<mpz_class>& right, boost::asio::ip::tcp::socket& sock,
+                                      int circuit=SEC_GDB_COMPARE_3WAY, int width=SEC_GDB_WIDTH_32);
+
+// min[i] gets an encryption of the smaller of left[i] and right[i], and
+// selector[i], if given, an encryption of 1 when left[i] is the smaller one.
+// Nobody learns which one it is. The values have to fit width like those
+// of secure_compare.
+void secure_min_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, boost::asio::ip::tcp::socket& sock,
+                             int width=SEC_GDB_WIDTH_32);
+void secure_min_batch(JL_PK& jl_pk, std::vector<mpz_class>& left, std::vector<mpz_class>& right, boost::asio::ip::tcp::socket& sock,
+                      std::vector<mpz_class>& min, std::vector<mpz_class>* selector=nullptr, int width=SEC_GDB_WIDTH_32);
+
+// Sign of each value against zero, COMPARE_HIGHER, COMPARE_EQUAL or
+// COMPARE_LOWER. compare_slots(width) values share a ciphertext and all of
+// them go in one request.
+void secure_sign_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, boost::asio::ip::tcp::socket& sock,
+                              int width=SEC_GDB_WIDTH_32);
+std::vector<int> secure_sign_batch(JL_PK& jl_pk, const std::vector<mpz_class>& values, boost::asio::ip::tcp::socket& sock,
+                                   int width=SEC_GDB_WIDTH_32);
 
 void secure_multiply_remote(JL_PK& jl_pk, JL_SK& jl_sk, boost::asio::ip::tcp::socket& sock);
 mpz_class secure_multiply(JL_PK& jl_pk, mpz_class& left, mpz_class& right, boost::asio::ip::tcp::socket& sock, int scaler=0);
@@ -34,6 +86,12 @@ void test_obc(ProtocolDesc& pd);
 extern size_t g_compare_counter;
 extern double g_compare_time_cost;
 
+extern size_t g_min_counter;
+extern double g_min_time_cost;
+
+extern size_t g_sign_counter;
+extern double g_sign_time_cost;
+
 extern size_t g_mul_counter;
 extern double g_mul_time_cost;
 
@@ -5,16 +5,79 @@
 #define SEC_GDB_OBLIVC_PROXY 1
 
 typedef int OBLIVC_DATA_TYPE;
+/* Inputs of the compare circuits, each circuit narrows them to its width. */
+typedef long long OBLIVC_WIDE_TYPE;
+
+/* Circuits for OBLIVC_IO. The three way one gives 1, 0 or -1 for left
+ * above, equal to or below right, the others 1 if the relation holds. */
+#define SEC_GDB_COMPARE_3WAY 0
+#define SEC_GDB_COMPARE_GT 1
+#define SEC_GDB_COMPARE_LT 2
+#define SEC_GDB_COMPARE_EQ 3
+
+/* Widths of the compare circuits, 32 bits is the default of old heads. */
+#define SEC_GDB_WIDTH_32 0
+#define SEC_GDB_WIDTH_16 1
+#define SEC_GDB_WIDTH_64 2
 
 typedef struct _OBLIVC_IO
 {
-    OBLIVC_DATA_TYPE a_1;
-    OBLIVC_DATA_TYPE a_2;
-    OBLIVC_DATA_TYPE r_1;
-    OBLIVC_DATA_TYPE r_2;
+    OBLIVC_WIDE_TYPE a_1;
+    OBLIVC_WIDE_TYPE a_2;
+    OBLIVC_WIDE_TYPE r_1;
+    OBLIVC_WIDE_TYPE r_2;
     int result;
 } OBLIVC_IO;
 
+/**
+ * Inputs and outputs of select_min, n pairs. The proxy feeds a_1 and a_2,
+ * the server the masks r_1, r_2 of the inputs, r_3 of the min and s of the
+ * selector. The proxy gets min + r_3 and (left < right) ^ s.
+ * Both parties need all the arrays, the ones of the other party are unused.
+ * Like OBLIVC_IO the values are wide, each width narrows them.
+*/
+typedef struct _OBLIVC_MIN_IO
+{
+    int n;
+    OBLIVC_WIDE_TYPE *a_1;
+    OBLIVC_WIDE_TYPE *a_2;
+    OBLIVC_WIDE_TYPE *r_1;
+    OBLIVC_WIDE_TYPE *r_2;
+    OBLIVC_WIDE_TYPE *r_3;
+    int *s;
+    OBLIVC_WIDE_TYPE *min;
+    int *sel;
+} OBLIVC_MIN_IO;
+
+/**
+ * Inputs and outputs of sign_test, n values. The proxy feeds a, the value
+ * under the mask r fed by the server. Both get the sign of a - r.
+*/
+typedef struct _OBLIVC_SIGN_IO
+{
+    int n;
+    OBLIVC_WIDE_TYPE *a;
+    OBLIVC_WIDE_TYPE *r;
+    int *result;
+} OBLIVC_SIGN_IO;
+
 void compare(void* args);
+void compare_gt(void* args);
+void compare_lt(void* args);
+void compare_eq(void* args);
+void compare16(void* args);
+void compare_gt16(void* args);
+void compare_lt16(void* args);
+void compare_eq16(void* args);
+void compare64(void* args);
+void compare_gt64(void* args);
+void compare_lt64(void* args);
+void compare_eq64(void* args);
+void select_min(void* args);
+void select_min16(void* args);
+void select_min64(void* args);
+void sign_test(void* args);
+void sign_test16(void* args);
+void sign_test64(void* args);
 
 #endif
\ No newline at end of file
@@ -15,6 +15,30 @@ const PROTOCOL_HEAD_TYPE MPC_SECURE_COMPARSION = 0x1;
 const PROTOCOL_HEAD_TYPE MPC_SECURE_MULTIPLICATION = 0x2;
 const PROTOCOL_HEAD_TYPE MPC_SECURE_INVERSE = 0x3;
 const PROTOCOL_HEAD_TYPE MPC_LOOK_UP = 0x4;
+const PROTOCOL_HEAD_TYPE MPC_SECURE_COMPARSION_BATCH = 0x5;
+const PROTOCOL_HEAD_TYPE MPC_SECURE_MIN = 0x6;
+const PROTOCOL_HEAD_TYPE MPC_SECURE_SIGN = 0x7;
+
+// The heads of the comparisons carry the circuit in the two bits above
+// the protocol bits, and its width in the top two.
+const PROTOCOL_HEAD_TYPE MPC_PROTOCOL_MASK = 0x0F;
+const int MPC_CIRCUIT_SHIFT = 4;
+const int MPC_WIDTH_SHIFT = 6;
+
+inline PROTOCOL_HEAD_TYPE protocol_head(PROTOCOL_HEAD_TYPE protocol, int circuit, int width=0)
+{
+    return (PROTOCOL_HEAD_TYPE)(protocol | (circuit << MPC_CIRCUIT_SHIFT) | (width << MPC_WIDTH_SHIFT));
+}
+
+inline int protocol_circuit(PROTOCOL_HEAD_TYPE head)
+{
+    return (head >> MPC_CIRCUIT_SHIFT) & 0x3;
+}
+
+inline int protocol_width(PROTOCOL_HEAD_TYPE head)
+{
+    return (head >> MPC_WIDTH_SHIFT) & 0x3;
+}
 
 /* Default value */
 const short PORT = 23333;
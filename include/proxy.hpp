@@ -40,7 +40,12 @@ private:
     void multiply(boost::asio::ip::tcp::socket& sock);
     
     // Function for secure comparsion
-    void compare(boost::asio::ip::tcp::socket& sock, ProtocolDesc& pd);
+    void compare(boost::asio::ip::tcp::socket& sock, ProtocolDesc& pd, int circuit, int width);
+    void compare_batch(boost::asio::ip::tcp::socket& sock, int circuit, int width);
+
+    // Function for oblivious secure min
+    void min(boost::asio::ip::tcp::socket& sock, int width);
+    void sign(boost::asio::ip::tcp::socket& sock, int width);
 
     // Function for lookup
     std::tuple<Constrain, size_t> lookup(std::string& P_u) const;
@@ -2,11 +2,13 @@
 #define SEC_GDB_H_SERVER
 
 #include <iostream>
+#include <cstring>
 #include <gmpxx.h>
 
 #include <tuple>
 #include <unordered_map>
 #include <list>
+#include <memory>
 #include <boost/heap/fibonacci_heap.hpp>
 #include <boost/asio.hpp>
 
@@ -19,7 +21,22 @@ extern "C"
 #include "ggm.h"
 #include "crypto_stuff.hpp"
 #include "graph.hpp"
+#include "cipher_column.hpp"
 #include "mpc.hpp"
+#include "thread_pool.hpp"
+#include "mask_pool.hpp"
+#include "lru_cache.hpp"
+#include "data_structures.hpp"
+
+// Budget of the query_dist result cache unless set_dist_cache says otherwise.
+#define DIST_CACHE_DEFAULT_MB 64
+
+// Shortest path engines of query_dist.
+#define DIST_ENGINE_DIJKSTRA 0
+#define DIST_ENGINE_BELLMAN_FORD 1
+#define DIST_ENGINE_LABELS 2
+#define DIST_ENGINE_ALT 3
+#define DIST_ENGINE_CH 4
 
 /* =========================================  */
 extern size_t g_fh_compare_time;
@@ -57,11 +74,19 @@ namespace std
     };
 };
 
-typedef struct _PATH_ITEM
+// A relaxation waiting for a secure min.
+typedef struct _RELAX_ITEM
+{
+    std::string P_v;
+    mpz_class dist;
+} RELAX_ITEM;
+
+// The landmark potential an A* search orders by, entry j of list dir.
+typedef struct _ALT_TARGET
 {
-    std::string prev;
-    mpz_class weight;
-} PATH_ITEM;
+    char dir;
+    uint32_t j;
+} ALT_TARGET;
 
 typedef struct _HEAP_ITEM
 {
@@ -69,10 +94,11 @@ typedef struct _HEAP_ITEM
     mpz_class distance;
 } HEAP_ITEM;
 
+// Key of a cached distance, P_s and P_t side by side.
 typedef struct _CACHE_ITEM
 {
-    std::string src;
-    std::string dest;
+    u_char src[KEY_SIZE];
+    u_char dest[KEY_SIZE];
 } CACHE_ITEM;
 
 namespace std
@@ -82,23 +108,64 @@ namespace std
     {
         bool operator()(const CACHE_ITEM &x, const CACHE_ITEM &y) const
         {
-            std::string tmp_x(x.src); tmp_x += x.dest;
-            std::string tmp_y(y.src); tmp_y += y.dest;
-            return tmp_x == tmp_y;
+            return memcmp(&x, &y, sizeof(CACHE_ITEM)) == 0;
         }
     };
 
     template<>
     struct hash<CACHE_ITEM>
     {
+        // P_s and P_t are PRF outputs, some of their bytes are a good hash.
         size_t operator()(const CACHE_ITEM &e) const
         {
-            std::string tmp(e.src); tmp += e.dest;
-            return std::hash<string>()(tmp);
+            size_t h_src, h_dest;
+            memcpy(&h_src, e.src, sizeof(size_t));
+            memcpy(&h_dest, e.dest, sizeof(size_t));
+            return h_src ^ (h_dest * 0x9e3779b97f4a7c15ULL);
         }
     };
 };
 
+/**
+ * Unlocked out edges of a vertex, one column per field so that workers can
+ * fill slot i without allocating. P_v and F_1_v hold KEY_SIZE bytes per edge.
+*/
+typedef struct _NEIGHBORS
+{
+    std::vector<u_char> P_v;
+    std::vector<u_char> F_1_v;
+    CipherColumn weight;
+
+    inline size_t size() const { return this->weight.size(); }
+    inline void resize(size_t n)
+    {
+        this->P_v.resize(n * KEY_SIZE);
+        this->F_1_v.resize(n * KEY_SIZE);
+        this->weight.resize(n);
+    }
+
+    inline std::string P(size_t i) const { return std::string((const char*)&this->P_v[i * KEY_SIZE], KEY_SIZE); }
+    inline std::string F_1(size_t i) const { return std::string((const char*)&this->F_1_v[i * KEY_SIZE], KEY_SIZE); }
+} NEIGHBORS;
+
+// Out edges of a vertex kept from an earlier query, valid while the vertex
+// still has ctr of them.
+typedef struct _UNLOCKED_ADJ
+{
+    size_t ctr;
+    NEIGHBORS neighbors;
+} UNLOCKED_ADJ;
+
+// Encrypted distances from one source to every vertex settled by the
+// search before the hop budget left one unexpanded, the later ones may not
+// be shortest. Unless complete, a budget stopped the search and a vertex
+// that is missing may still be reachable.
+typedef struct _DIST_MAP
+{
+    std::unordered_map<std::string, mpz_class> dist;
+    bool complete;
+} DIST_MAP;
+
 class FibHeapCompare;
 /* =========================================  */
 class Server
@@ -121,26 +188,54 @@ private:
     // The D_e as same as the one in client.
     std::unordered_map<std::string, std::string> D_e;
 
+    // D_l of the client, the encrypted hub labels. Empty unless
+    // set_label_index gives it one.
+    std::unordered_map<std::string, std::string> D_l;
+
+    // D_a of the client, the encrypted landmark potentials.
+    std::unordered_map<std::string, std::string> D_a;
+
     // Stroe F_1_X keys for each P_X
     std::unordered_map<std::string, std::string> D_key;
 
     // Parameters used during find max flow.
     std::unordered_map<ENC_E_ITEM, mpz_class> cap_r;
-    std::unordered_map<std::string, size_t> level;
+    std::vector<int> level;
 
     // Parameters used during find shortest distance.
-    std::unordered_map<std::string, PATH_ITEM> path;
     std::unordered_map<std::string, mpz_class> xi;
 
     // Store an temporary graph in server with blinded vertex and encrypted weight.
-    Graph<mpz_class> sever_graph;
+    // It is the residual graph, arc_open tells which reverse edges have been
+    // used so far, the others are known to be zero and are skipped.
+    // The capacities are kept in caps by edge index, not in the graph.
+    CSRGraph<mpz_class> sever_graph;
+    CipherColumn caps;
+    std::vector<char> arc_open;
 
     // An encrypted zero.
     mpz_class zero;
 
-    // Cache store history.
-    std::unordered_map<CACHE_ITEM, mpz_class> cache;
+    // Width of the compare, min and sign circuits and the bound it was
+    // picked for, see set_value_bound.
+    int cmp_width;
+    mpz_class value_bound;
+
+    // Workers unlocking the out edges of high degree vertices.
+    std::unique_ptr<ThreadPool> pool;
+
+    // Blinding masks encrypted in the background, see set_mask_pool.
+    std::unique_ptr<MaskPool> masks;
 
+    // Unlocked adjacency by P_u, shared by the queries on the same D_e.
+    // Disabled unless set_unlock_cache gives it a budget.
+    LRUCache<std::string, UNLOCKED_ADJ> adj_cache;
+    // Counters of the vertices the updates went to. A cached adjacency of
+    // another counter is stale and unlocked again.
+    std::unordered_map<std::string, size_t> vertex_ctr;
+
+    // Distances of earlier queries, bounded by set_dist_cache.
+    LRUCache<CACHE_ITEM, mpz_class> cache;
 
     /* Private functions */
     // Prepare network stuff
@@ -149,20 +244,87 @@ private:
     // Prepare obliv-c stuff
     void oblivc_init();
 
-    // Unlock an edge
-    void recover_masked_edge_info(u_char* F_1_u, u_char* sub_key, std::string& P_v, std::string& F_1_v, mpz_class& ei);
+    // Unlock an edge into slot i of out
+    void recover_masked_edge_info(const u_char* token, NEIGHBORS& out, size_t i) const;
 
     // Recover adjacency vertces of the chosen vertex
-    std::vector<std::tuple<std::string, std::string, mpz_class>> unlock_adjacency_vertexes(std::string& F_1_u, Subkeys& sub_keys, int ctr);
+    void unlock_adjacency_vertexes(const std::string& F_1_u, Subkeys& sub_keys, int ctr, NEIGHBORS& out);
+
+    // Out edges of the source of a request, or of any other vertex whose
+    // sub keys come from the proxy. Cached adjacency is returned when there
+    // is some, otherwise it is unlocked into scratch.
+    const NEIGHBORS& unlock_source(const std::string& F_1_s, const std::string& P_s, Constrain& constrained_key, size_t ctr, NEIGHBORS& scratch);
+    const NEIGHBORS& unlock_vertex(GGM& ggm, const std::string& P_u, NEIGHBORS& scratch);
+    void cache_unlocked(const std::string& P_u, size_t ctr, const NEIGHBORS& neighbors);
+
+    // Remember a query_dist result.
+    void cache_dist(const CACHE_ITEM& key, const mpz_class& dist);
 
     // Contact with proxy for getting sub keys of GGM
     int contact_and_get_ggm_sub_key(GGM& ggm, Subkeys& sub_key, std::string& P_t);
 
     // Divides each out edge weight by their sum
-    void normalize_graph_outedge_weight(std::tuple<Graph<mpz_class>, Graph<mpz_class>>& double_graph);
+    void normalize_graph_outedge_weight(const CSRGraph<mpz_class>& graph, CipherColumn& weights);
+
+    // Dijkstra from P_s, it stops once P_t (when given) or max_settled
+    // vertices are settled and does not expand vertices max_hops edges away
+    // along the fewest-edge path found, 0 means no limit. Settled vertices
+    // are appended to settled, their distances are in xi. Returns false if
+    // a budget cut the search short.
+    // Only distances settled before the hop budget stopped an expansion
+    // go into the dist cache, the later ones may not be shortest. exact,
+    // when given, gets how many leading entries of settled are final.
+    // With alt the heap is ordered by xi plus the landmark potential.
+    bool shortest_paths(const std::string& F_1_s, const std::string& P_s, const std::string* P_t, Constrain& constrained_key, size_t ctr,
+                        size_t max_settled, size_t max_hops, std::vector<std::string>& settled, const ALT_TARGET* alt=nullptr,
+                        size_t* exact=nullptr);
+
+    // Entry j of the landmark list dir of the vertex keyed by F_1_v.
+    bool unlock_landmark(const std::string& F_1_v, char dir, uint32_t j, mpz_class& out) const;
+
+    // The landmark and direction with the best lower bound from s to t.
+    bool pick_landmark(const std::string& F_1_s, const std::string& F_1_t, ALT_TARGET& alt) const;
+
+    // Bellman-Ford from P_s, one round per hop. All the out edges of the
+    // vertices improved in a round are relaxed in the next one, the
+    // compares of a round go out in batches.
+    mpz_class query_dist_bf(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr);
+
+    // Unlock the label list dir of the vertex keyed by F_1_v into hub tag
+    // and encrypted distance pairs.
+    void unlock_labels(const std::string& F_1_v, char dir, std::vector<std::pair<std::string, mpz_class>>& out) const;
+
+    // Smallest value of each group into out, with batched compares.
+    void min_of_groups(std::vector<std::vector<mpz_class>>& groups, std::vector<mpz_class>& out) const;
+    // Same with secure min, nothing about the order is revealed.
+    void secure_min_of_groups(std::vector<std::vector<mpz_class>>& groups, std::vector<mpz_class>& out) const;
+
+    // Unlock the hierarchy edges dir of the vertex keyed by F_1_u.
+    void unlock_ch_edges(const std::string& F_1_u, char dir, NEIGHBORS& out) const;
+
+    // Distances from P_s to every vertex above it in the hierarchy, along
+    // the up edges, or to P_s along the down edges. The vertices above P_s
+    // form a DAG, each layer of it takes one round of secure mins.
+    void upward_search(const std::string& F_1_s, const std::string& P_s, char dir, std::unordered_map<std::string, mpz_class>& dist);
+
+    // Blocking flow of at most gamma from s to t in the level graph, one
+    // path at a time with current arcs. Dead ends leave the level graph.
+    mpz_class augment(uint32_t s, uint32_t t, const mpz_class& gamma);
 
     // Contact with proxy for comparing two encryption value
     bool compare(const mpz_class& left, const mpz_class& right, int mode) const;
+    // Same as compare on each pair, MAX_COMPARE_BATCH pairs per round trip
+    std::vector<bool> compare_batch(const std::vector<mpz_class>& left, const std::vector<mpz_class>& right, int mode) const;
+
+    // Whether each value is above zero. One request and one circuit for
+    // the whole batch, a ciphertext carries MAX_COMPARE_BATCH values.
+    bool is_positive(const mpz_class& value) const;
+    std::vector<bool> is_positive_batch(const std::vector<mpz_class>& values) const;
+
+    // Contact with proxy for the smaller of each pair, without learning
+    // which one it is. selector gets encryptions of 1 where left is smaller.
+    void secure_min(const std::vector<mpz_class>& left, const std::vector<mpz_class>& right, std::vector<mpz_class>& min,
+                    std::vector<mpz_class>* selector=nullptr) const;
 
     // Contact with proxy for multiplying two encryption value
     mpz_class multiply (mpz_class& left, mpz_class& right, int scaler=0);
@@ -176,19 +338,95 @@ public:
     ~Server();
 
     inline const PK &get_pk() const { return pk; }
+    inline void set_threads(int threads) { this->pool.reset(new ThreadPool(threads)); }
     inline void set_params(const std::unordered_map<std::string, std::string> &de, const PK &pk)
     {
         this->D_e = de;
         this->pk = pk;
+        this->adj_cache.clear();
+        this->cache.clear();
+        this->vertex_ctr.clear();
+        // The masks were encrypted under the old key.
+        this->set_mask_pool(0);
+    }
+
+    // Largest value compare, min and sign have to tell apart, in absolute
+    // value. Picks the narrowest circuits for it, SEC_GDB_INF unless set.
+    // query_flow caps its infinite capacity at the bound.
+    inline void set_value_bound(const mpz_class& bound)
+    {
+        this->cmp_width = compare_width(bound);
+        this->value_bound = abs(bound);
+    }
+    inline int get_compare_width() const { return this->cmp_width; }
+
+    // Keep depth blinding masks of each size encrypted ahead of time by
+    // threads background workers, so the secure compares, mins and
+    // multiplications skip the encryptions. 0 turns it off.
+    void set_mask_pool(size_t depth, int threads=1);
+    inline MaskPool* get_mask_pool() { return this->masks.get(); }
+    inline const MaskPool* get_mask_pool() const { return this->masks.get(); }
+
+    // Keep up to bytes of unlocked adjacency across queries, 0 turns it off.
+    void set_unlock_cache(size_t bytes);
+    // Has to be called once an update changed the out edges of P_u.
+    void invalidate_unlock_cache(const std::string& P_u);
+    inline const LRUCache<std::string, UNLOCKED_ADJ>& get_unlock_cache() const { return this->adj_cache; }
+
+    // Keep up to bytes of query_dist results, 0 turns the cache off.
+    void set_dist_cache(size_t bytes);
+    // Any update may change any distance, all of them are dropped.
+    void invalidate_dist_cache();
+    inline const LRUCache<CACHE_ITEM, mpz_class>& get_dist_cache() const { return this->cache; }
+
+    // Persist the cached distances, load_dist_cache warms up a new server.
+    bool save_dist_cache(const std::string& path) const;
+    bool load_dist_cache(const std::string& path);
+
+    // The labels are built once at encryption time, see Client::enc_hub_labels.
+    inline void set_label_index(const std::unordered_map<std::string, std::string> &dl) { this->D_l = dl; }
+    inline bool has_label_index() const { return !this->D_l.empty(); }
+
+    // Landmark potentials from Client::enc_landmarks, also static.
+    inline void set_landmark_index(const std::unordered_map<std::string, std::string> &da) { this->D_a = da; }
+    inline bool has_landmark_index() const { return !this->D_a.empty(); }
+
+    // Add the edge record of an update from Client::update_graph and drop
+    // what it makes stale.
+    void apply_update(const U_ITEM& update);
+
+    // Drop everything an update of the out edges of P_u makes stale,
+    // including the labels and landmarks, which can not be updated.
+    inline void on_graph_update(const std::string& P_u)
+    {
+        this->invalidate_unlock_cache(P_u);
+        this->invalidate_dist_cache();
+        this->D_l.clear();
+        this->D_a.clear();
     }
 
     void build_server_graph(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr);
     bool set_level(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr);
     mpz_class augment_path(std::string &F_1_u, std::string &P_u, std::string &P_t, Constrain &constrain, size_t ctr, mpz_class gamma);
     mpz_class query_flow(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr);
-    mpz_class query_dist(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr);
+    mpz_class query_dist(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr, int engine=DIST_ENGINE_DIJKSTRA);
+    // Distance from the hub labels of s and t, no edge is unlocked. The
+    // sums over the common hubs are reduced by secure min.
+    mpz_class query_dist_label(const std::string &F_1_s, const std::string &P_s, const std::string &F_1_t, const std::string &P_t);
+    // Distance from an upward search from s and a downward one to t over
+    // the contraction hierarchy, they meet at the highest vertex of a
+    // shortest path. Needs the shortcuts of Client::enc_shortcuts in D_e,
+    // which reveal the hierarchy above any vertex whose F_1 the server has.
+    mpz_class query_dist_ch(const std::string &F_1_s, const std::string &P_s, const std::string &F_1_t, const std::string &P_t);
+    // query_dist as an A* search towards t, ordered by the landmark lower
+    // bounds. Same as query_dist without a landmark index.
+    mpz_class query_dist_alt(std::string &F_1_s, std::string &P_s, const std::string &F_1_t, std::string &P_t, Constrain &constrained_key, size_t ctr);
+    // query_dist of many requests at once, requests from the same source
+    // share one search and the searches share unlocked vertices and compares.
+    std::vector<mpz_class> query_dist_batch(std::vector<Request>& reqs);
+    DIST_MAP query_dist_all(std::string &F_1_s, std::string &P_s, Constrain &constrained_key, size_t ctr, size_t max_vertices=0, size_t max_hops=0);
     std::unordered_map<Vertex, mpz_class> page_rank(std::string &F_1_s, std::string &P_s, Constrain &constrained_key, size_t ctr , int epochs);
-    void unlock_graph(std::tuple<Graph<mpz_class>, Graph<mpz_class>>& double_graph, std::string& F_1_s, std::string& P_s, Constrain& constrained_key, size_t ctr);
+    void unlock_graph(CSRGraph<mpz_class>& graph, std::string& F_1_s, std::string& P_s, Constrain& constrained_key, size_t ctr);
 };
 
 /* =========================================  */
@@ -0,0 +1,45 @@
+#ifndef SEC_GDB_H_THREAD_POOL
+#define SEC_GDB_H_THREAD_POOL
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * A tiny fixed-size pool of workers.
+ * The calling thread always takes part in parallel_for, so a pool created
+ * with a single thread spawns nothing and runs everything inline.
+*/
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop;
+
+    void worker_loop();
+
+public:
+    explicit ThreadPool(int threads = 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads taking part in parallel_for, the caller included.
+    inline int size() const { return (int)this->workers.size() + 1; }
+
+    // Split [0, n) into chunks of grain items and run body(begin, end, slot)
+    // on them. Slot is in [0, size()) and is unique for each running thread,
+    // so it can index thread-local outputs. Blocks until every chunk is done
+    // and rethrows the first exception raised by body.
+    void parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t, int)> &body);
+};
+
+#endif // SEC_GDB_H_THREAD_POOL
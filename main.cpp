@@ -85,6 +85,12 @@ size_t g_fh_compare_time = 0;
 size_t g_compare_counter = 0;
 double g_compare_time_cost = 0.0;
 
+size_t g_min_counter = 0;
+double g_min_time_cost = 0.0;
+
+size_t g_sign_counter = 0;
+double g_sign_time_cost = 0.0;
+
 size_t g_mul_counter = 0;
 double g_mul_time_cost = 0.0;
 
@@ -138,14 +144,73 @@ void enc_graph(cxxopts::ParseResult& args)
         scaler = SCALE_SHIFT_P;
     }
 
+    bool stream = args["stream"].as<bool>();
+    size_t num_landmarks = args["landmarks"].as<size_t>();
+    bool shortcuts = args["shortcuts"].as<bool>();
+    // Only the stream mode saves the keys and D_e, the indexes would be
+    // under keys nobody has.
+    if (!stream && (num_landmarks > 0 || shortcuts))
+    {
+        cerr << "--landmarks and --shortcuts need --stream" << endl;
+        return;
+    }
+    // Every D_e record is hashed to one of the shards.
+    if (stream && args["shards"].as<int>() < 1)
+    {
+        cerr << "--shards has to be at least 1" << endl;
+        return;
+    }
+
     auto enc_start = chrono::high_resolution_clock::now();
-    client.enc_graph(args["infile"].as<string>(), scaler);
+    if (stream)
+    {
+        // D_e goes straight to the shards in outdir
+        if (!client.enc_graph_stream(args["infile"].as<string>(), outdir.string(), scaler, args["threads"].as<int>(),
+                                     args["chunk"].as<size_t>(), args["shards"].as<int>()))
+        {
+            return;
+        }
+    }
+    else
+    {
+        client.enc_graph(args["infile"].as<string>(), scaler, args["threads"].as<int>());
+    }
     auto enc_end = chrono::high_resolution_clock::now();
 
     double enc_time = chrono::duration<double>(enc_end-enc_start).count();
     cout << enc_time << endl;
 
-    j["exps"].push_back({{"enc", enc_time}});
+    // The stream mode does not keep the graph.
+    if (num_landmarks > 0 || shortcuts)
+    {
+        client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
+    }
+
+    if (shortcuts)
+    {
+        auto ch_start = chrono::high_resolution_clock::now();
+        // One more shard after those of enc_graph_stream.
+        unordered_map<string, string> D_ch;
+        if (client.enc_shortcuts(scaler, args["threads"].as<int>(), &D_ch))
+        {
+            append_De_shard(outdir, D_ch);
+        }
+        auto ch_end = chrono::high_resolution_clock::now();
+        cout << "Shortcuts: " << chrono::duration<double>(ch_end - ch_start).count() << endl;
+    }
+
+    if (num_landmarks > 0)
+    {
+        auto alt_start = chrono::high_resolution_clock::now();
+        if (client.enc_landmarks(num_landmarks, scaler, args["threads"].as<int>()))
+        {
+            client.save_da((outdir.remove_trailing_separator() / "da.bin").string());
+        }
+        auto alt_end = chrono::high_resolution_clock::now();
+        cout << "Landmarks: " << chrono::duration<double>(alt_end - alt_start).count() << endl;
+    }
+
+    j["exps"].push_back({{"enc", enc_time}, {"threads", args["threads"].as<int>()}});
     double avg_enc_time = 0;
     int ctr = 0;
     for (auto each : j["exps"])
@@ -158,6 +223,14 @@ void enc_graph(cxxopts::ParseResult& args)
 
     os << j.dump() << endl;
 
+    if (stream)
+    {
+        // Without them the shards can never be queried.
+        client.store_pk((outdir.remove_trailing_separator() / "pk.json").string());
+        client.store_sk((outdir.remove_trailing_separator() / "sk.json").string());
+        client.save_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
+        client.save_dpv((outdir.remove_trailing_separator() / "dpv.bin").string());
+    }
 
     // save_pk((outdir.remove_trailing_separator() / "pk.json"), client.get_pk());
     // save_sk((outdir.remove_trailing_separator() / "sk.json"), client.get_sk());
@@ -167,6 +240,160 @@ void enc_graph(cxxopts::ParseResult& args)
     // save_De((outdir.remove_trailing_separator() / "de.bin"), client.get_De());
 }
 
+/**
+ * Encrypt the hub labels of infile with the keys in outdir into dl.bin,
+ * which query_dist loads for --engine labels.
+*/
+void enc_labels(cxxopts::ParseResult& args)
+{
+    fs::path outdir(args["outdir"].as<string>());
+
+    Client client;
+    client.read_pk((outdir.remove_trailing_separator() / "pk.json").string());
+    client.read_sk((outdir.remove_trailing_separator() / "sk.json").string());
+    client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
+
+    int scaler = 0;
+    if (args["scale"].as<bool>())
+    {
+        scaler = SCALE_SHIFT_P;
+    }
+
+    auto enc_start = chrono::high_resolution_clock::now();
+    if (!client.enc_hub_labels(scaler, args["threads"].as<int>()))
+    {
+        return;
+    }
+    auto enc_end = chrono::high_resolution_clock::now();
+
+    client.save_dl((outdir.remove_trailing_separator() / "dl.bin").string());
+
+    size_t n = client.get_graph().vertices.size();
+    cout << chrono::duration<double>(enc_end - enc_start).count() << endl;
+    cout << client.get_Dl().size() << " labels, " << (n == 0 ? 0.0 : double(client.get_Dl().size()) / n)
+         << " per vertex" << endl;
+}
+
+/**
+ * Pairs to query in one session. --queries names a file with a "start end"
+ * pair per line, otherwise --start and --end give a single pair.
+*/
+vector<pair<string, string>> query_pairs(cxxopts::ParseResult& args)
+{
+    vector<pair<string, string>> pairs;
+    if (args.count("queries"))
+    {
+        ifstream in(args["queries"].as<string>());
+        string src, dest;
+        while (in >> src >> dest)
+        {
+            pairs.emplace_back(src, dest);
+        }
+        if (pairs.empty()) { cerr << "No query read from " << args["queries"].as<string>() << endl; }
+        return pairs;
+    }
+    pairs.emplace_back(args["start"].as<string>(), args["end"].as<string>());
+    return pairs;
+}
+
+/**
+ * Shortest path engine named by --engine, dijkstra, bellman-ford, labels, alt
+ * or ch. ch needs the graph encrypted with --shortcuts.
+*/
+int dist_engine(cxxopts::ParseResult& args)
+{
+    const string& engine = args["engine"].as<string>();
+    if (engine == "bellman-ford") { return DIST_ENGINE_BELLMAN_FORD; }
+    if (engine == "labels") { return DIST_ENGINE_LABELS; }
+    if (engine == "alt") { return DIST_ENGINE_ALT; }
+    if (engine == "ch") { return DIST_ENGINE_CH; }
+    if (engine != "dijkstra") { cerr << "Unknown engine " << engine << ", using dijkstra" << endl; }
+    return DIST_ENGINE_DIJKSTRA;
+}
+
+/**
+ * Narrows the compare, min and sign circuits of the server to --value-bound,
+ * the longest distance or the largest flow a query can see. It is scaled
+ * like the weights with --scale, and doubled for alt whose heap keys add a
+ * potential to a distance.
+*/
+void set_value_bound(Server& server, cxxopts::ParseResult& args)
+{
+    size_t bound = args["value-bound"].as<size_t>();
+    if (bound == 0) { return; }
+
+    mpz_class value(bound);
+    if (args["scale"].as<bool>()) { value <<= SCALE_SHIFT_P; }
+    if (dist_engine(args) == DIST_ENGINE_ALT) { value *= 2; }
+    server.set_value_bound(value);
+    cout << "Compare circuits of " << width_bits(server.get_compare_width()) << " bits" << endl;
+}
+
+/**
+ * Starts --mask-pool masks of each size encrypting in the background and
+ * waits for the first fill, the time before the first query is idle.
+*/
+void set_mask_pool(Server& server, cxxopts::ParseResult& args)
+{
+    size_t depth = args["mask-pool"].as<size_t>();
+    if (depth == 0) { return; }
+
+    auto start = chrono::high_resolution_clock::now();
+    server.set_mask_pool(depth);
+    server.get_mask_pool()->wait_full();
+    cout << "Mask pool filled in " << chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() << "s" << endl;
+}
+
+void print_mask_pool_stats(const Server& server)
+{
+    const MaskPool* masks = server.get_mask_pool();
+    if (masks == nullptr) { return; }
+    cout << "Mask pool: " << masks->hits() << " masks ready, " << masks->misses() << " made on demand" << endl;
+}
+
+/**
+ * Insert the "src dest weight" edges of path on the client and hand each
+ * update to the server, which drops the adjacency and distances it makes
+ * stale, loaded from a cache file or not.
+*/
+void apply_updates(Client& client, Server& server, const string& path)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        cerr << "Can not open updates " << path << endl;
+        return;
+    }
+    string src, dest;
+    size_t weight, n = 0;
+    while (in >> src >> dest >> weight)
+    {
+        U_ITEM update;
+        client.update_graph(src, dest, weight, SEC_GDB_UPDATE_OP_ADD, &update);
+        server.apply_update(update);
+        n++;
+    }
+    cout << "Applied " << n << " updates" << endl;
+}
+
+void print_unlock_cache_stats(const Server& server)
+{
+    auto& cache = server.get_unlock_cache();
+    if (!cache.enabled()) { return; }
+    cout << "Unlock cache: " << cache.hits() << " hits, " << cache.misses() << " misses ("
+         << cache.hit_rate() * 100 << "%), " << cache.size() << " vertices in "
+         << cache.bytes() << " bytes, " << cache.evictions() << " evicted" << endl;
+}
+
+void print_dist_cache_stats(const Server& server)
+{
+    auto& cache = server.get_dist_cache();
+    if (!cache.enabled()) { return; }
+    cout << "Distance cache: " << cache.hits() << " hits, " << cache.misses() << " misses ("
+         << cache.hit_rate() * 100 << "%), " << cache.size() << " pairs in "
+         << cache.bytes() << " bytes, " << cache.evictions() << " evicted" << endl;
+}
+
 void query_flow(cxxopts::ParseResult& args)
 {
     fs::path outdir(args["outdir"].as<string>());
@@ -178,7 +405,7 @@ void query_flow(cxxopts::ParseResult& args)
     init_global_key(outdir.string().c_str());
 
     // client.enc_graph(args["infile"].as<string>());
-    client.set_graph(args["infile"].as<string>());
+    client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
     client.load_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
     client.load_de((outdir.remove_trailing_separator() / "de.bin").string());
     client.load_dpv((outdir.remove_trailing_separator() / "dpv.bin").string());
@@ -188,19 +415,35 @@ void query_flow(cxxopts::ParseResult& args)
     tcp::socket sock(service);
 
     Server server(client.get_De(), client.get_pk(), sock, ep);
-    // Request reqs = client.give_request("0", "5");
-    Request reqs = client.give_request(args["start"].as<string>(), args["end"].as<string>());
+    server.set_threads(args["threads"].as<int>());
+    server.set_unlock_cache(args["unlock-cache"].as<size_t>() << 20);
+    set_value_bound(server, args);
+    set_mask_pool(server, args);
 
-    auto query_start = chrono::high_resolution_clock::now();
-    mpz_class result_enc = server.query_flow(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr);
-    // mpz_class result_enc = server.query_dist(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr);
-    auto query_end = chrono::high_resolution_clock::now();
+    for (auto& query : query_pairs(args))
+    {
+        Request reqs = client.give_request(query.first, query.second);
+        if (!reqs.validity)
+        {
+            cerr << "Invalid query " << query.first << " -> " << query.second << endl;
+            continue;
+        }
+
+        auto query_start = chrono::high_resolution_clock::now();
+        mpz_class result_enc = server.query_flow(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr);
+        auto query_end = chrono::high_resolution_clock::now();
+        ggm_free_constrain(&reqs.constrained_key);
 
-    cout << chrono::duration<double>(query_end - query_start).count() << endl;
+        cout << chrono::duration<double>(query_end - query_start).count() << endl;
 
-    mpz_class enc;
-    JL_decryption(client.get_sk(), client.get_pk(), result_enc, enc);
-    cout << "The final result is: " << enc.get_str() << endl;
+        mpz_class enc;
+        JL_decryption(client.get_sk(), client.get_pk(), result_enc, enc);
+        cout << "The final result is: " << enc.get_str() << endl;
+    }
+    cout << "Secure compares: " << g_compare_counter << ", secure sign tests: " << g_sign_counter
+         << " in " << g_sign_time_cost << "s" << endl;
+    print_unlock_cache_stats(server);
+    print_mask_pool_stats(server);
 }
 
 void query_dist(cxxopts::ParseResult& args)
@@ -216,7 +459,7 @@ void query_dist(cxxopts::ParseResult& args)
     init_global_key(outdir.string().c_str());
 
     // client.enc_graph(args["infile"].as<string>());
-    client.set_graph(args["infile"].as<string>());
+    client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
     client.load_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
     client.load_de((outdir.remove_trailing_separator() / "de.bin").string());
     client.load_dpv((outdir.remove_trailing_separator() / "dpv.bin").string());
@@ -235,18 +478,264 @@ void query_dist(cxxopts::ParseResult& args)
     tcp::socket sock(service);
 
     Server server(client.get_De(), client.get_pk(), sock, ep);
-    // Request reqs = client.give_request("0", "8");
-    Request reqs = client.give_request(args["start"].as<string>(), args["end"].as<string>());
-    
-    auto query_start = chrono::high_resolution_clock::now();
-    mpz_class result_enc = server.query_dist(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr);
-    auto query_end = chrono::high_resolution_clock::now();
+    server.set_threads(args["threads"].as<int>());
+    server.set_unlock_cache(args["unlock-cache"].as<size_t>() << 20);
+    server.set_dist_cache(args["dist-cache"].as<size_t>() << 20);
+    set_value_bound(server, args);
+    set_mask_pool(server, args);
+    int engine = dist_engine(args);
+    if (engine == DIST_ENGINE_LABELS)
+    {
+        if (client.load_dl((outdir.remove_trailing_separator() / "dl.bin").string()))
+        {
+            server.set_label_index(client.get_Dl());
+        }
+        else
+        {
+            cerr << "No dl.bin in " << outdir.string() << ", run enc_labels first. Using dijkstra" << endl;
+            engine = DIST_ENGINE_DIJKSTRA;
+        }
+    }
+    if (engine == DIST_ENGINE_ALT)
+    {
+        if (client.load_da((outdir.remove_trailing_separator() / "da.bin").string()))
+        {
+            server.set_landmark_index(client.get_Da());
+        }
+        else
+        {
+            cerr << "No da.bin in " << outdir.string() << ", run enc_graph --stream with --landmarks. Using dijkstra" << endl;
+            engine = DIST_ENGINE_DIJKSTRA;
+        }
+    }
+    if (args.count("dist-cache-file"))
+    {
+        server.load_dist_cache(args["dist-cache-file"].as<string>());
+    }
+    if (args.count("updates"))
+    {
+        apply_updates(client, server, args["updates"].as<string>());
+        // The indexes are of the graph before the updates.
+        if (engine == DIST_ENGINE_LABELS || engine == DIST_ENGINE_ALT || engine == DIST_ENGINE_CH)
+        {
+            cerr << "The updates made the index of --engine " << args["engine"].as<string>() << " stale. Using dijkstra" << endl;
+            engine = DIST_ENGINE_DIJKSTRA;
+        }
+    }
+
+    for (auto& query : query_pairs(args))
+    {
+        Request reqs = client.give_request(query.first, query.second);
+        if (!reqs.validity)
+        {
+            cerr << "Invalid query " << query.first << " -> " << query.second << endl;
+            continue;
+        }
+
+        auto query_start = chrono::high_resolution_clock::now();
+        mpz_class result_enc;
+        if (engine == DIST_ENGINE_LABELS)
+        {
+            result_enc = server.query_dist_label(reqs.F_1_s, reqs.P_s, reqs.F_1_t, reqs.P_t);
+        }
+        else if (engine == DIST_ENGINE_CH)
+        {
+            result_enc = server.query_dist_ch(reqs.F_1_s, reqs.P_s, reqs.F_1_t, reqs.P_t);
+        }
+        else if (engine == DIST_ENGINE_ALT)
+        {
+            result_enc = server.query_dist_alt(reqs.F_1_s, reqs.P_s, reqs.F_1_t, reqs.P_t, reqs.constrained_key, reqs.ctr);
+        }
+        else
+        {
+            result_enc = server.query_dist(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr, engine);
+        }
+        auto query_end = chrono::high_resolution_clock::now();
+        ggm_free_constrain(&reqs.constrained_key);
+
+        cout << chrono::duration<double>(query_end - query_start).count() << endl;
 
-    cout << chrono::duration<double>(query_end - query_start).count() << endl;
+        mpz_class enc;
+        JL_decryption(client.get_sk(), client.get_pk(), result_enc, enc);
+        cout << "The final result is: " << enc.get_str() << endl;
+    }
+    cout << "Secure compares: " << g_compare_counter << ", secure mins: " << g_min_counter << endl;
+    print_unlock_cache_stats(server);
+    print_mask_pool_stats(server);
+    print_dist_cache_stats(server);
 
-    mpz_class enc;
-    JL_decryption(client.get_sk(), client.get_pk(), result_enc, enc);
-    cout << "The final result is: " << enc.get_str() << endl;
+    if (args.count("dist-cache-file"))
+    {
+        server.save_dist_cache(args["dist-cache-file"].as<string>());
+    }
+}
+
+/**
+ * query_dist for pairs that share sources, one search per source answers all
+ * of its targets. --max-vertices and --max-hops bound the search, targets it
+ * did not settle fall back to query_dist.
+*/
+void query_dist_all(cxxopts::ParseResult& args)
+{
+    fs::path outdir(args["outdir"].as<string>());
+
+    Client client;
+    client.read_pk((outdir.remove_trailing_separator() / "pk.json").string());
+    client.read_sk((outdir.remove_trailing_separator() / "sk.json").string());
+
+    init_dbg_client(outdir.string().c_str());
+    init_global_key(outdir.string().c_str());
+
+    client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
+    client.load_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
+    client.load_de((outdir.remove_trailing_separator() / "de.bin").string());
+    client.load_dpv((outdir.remove_trailing_separator() / "dpv.bin").string());
+
+    asio::io_service service;
+    tcp::endpoint ep(asio::ip::address::from_string(args["address"].as<string>()), args["port"].as<short>());
+    tcp::socket sock(service);
+
+    Server server(client.get_De(), client.get_pk(), sock, ep);
+    server.set_threads(args["threads"].as<int>());
+    server.set_unlock_cache(args["unlock-cache"].as<size_t>() << 20);
+    server.set_dist_cache(args["dist-cache"].as<size_t>() << 20);
+    set_value_bound(server, args);
+    set_mask_pool(server, args);
+
+    // Targets of each source, sources in the order they first show up.
+    vector<string> sources;
+    unordered_map<string, vector<string>> targets;
+    for (auto& query : query_pairs(args))
+    {
+        if (targets.find(query.first) == targets.end()) { sources.push_back(query.first); }
+        targets[query.first].push_back(query.second);
+    }
+
+    size_t max_vertices = args["max-vertices"].as<size_t>();
+    size_t max_hops = args["max-hops"].as<size_t>();
+    for (auto& src : sources)
+    {
+        DIST_MAP dists;
+        bool searched = false;
+        for (auto& dest : targets[src])
+        {
+            Request reqs = client.give_request(src, dest);
+            if (!reqs.validity)
+            {
+                cerr << "Invalid query " << src << " -> " << dest << endl;
+                continue;
+            }
+
+            auto query_start = chrono::high_resolution_clock::now();
+            if (!searched)
+            {
+                dists = server.query_dist_all(reqs.F_1_s, reqs.P_s, reqs.constrained_key, reqs.ctr, max_vertices, max_hops);
+                searched = true;
+            }
+
+            mpz_class result_enc;
+            auto it = dists.dist.find(reqs.P_t);
+            if (it != dists.dist.end())
+            {
+                result_enc = it->second;
+            }
+            else if (dists.complete)
+            {
+                // Not reachable from src.
+                JL_encryption(client.get_pk(), 0, result_enc);
+            }
+            else
+            {
+                // Beyond the budget, or settled after the hop budget left a
+                // vertex unexpanded, so its distance may not be shortest.
+                result_enc = server.query_dist(reqs.F_1_s, reqs.P_s, reqs.P_t, reqs.constrained_key, reqs.ctr);
+            }
+            auto query_end = chrono::high_resolution_clock::now();
+            ggm_free_constrain(&reqs.constrained_key);
+
+            cout << chrono::duration<double>(query_end - query_start).count() << endl;
+
+            mpz_class enc;
+            JL_decryption(client.get_sk(), client.get_pk(), result_enc, enc);
+            cout << src << " -> " << dest << ": " << enc.get_str() << endl;
+        }
+        if (searched)
+        {
+            cout << "Exact distances of " << dists.dist.size() << " vertices from " << src
+                 << (dists.complete ? "" : " before hitting the budget") << endl;
+        }
+    }
+    print_unlock_cache_stats(server);
+    print_mask_pool_stats(server);
+    print_dist_cache_stats(server);
+}
+
+/**
+ * query_dist over --queries, --lockstep requests at a time through
+ * Server::query_dist_batch. Reports the throughput in queries per second.
+*/
+void query_dist_batch(cxxopts::ParseResult& args)
+{
+    fs::path outdir(args["outdir"].as<string>());
+
+    Client client;
+    client.read_pk((outdir.remove_trailing_separator() / "pk.json").string());
+    client.read_sk((outdir.remove_trailing_separator() / "sk.json").string());
+
+    init_dbg_client(outdir.string().c_str());
+    init_global_key(outdir.string().c_str());
+
+    client.set_graph(args["infile"].as<string>(), args["threads"].as<int>());
+    client.load_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
+    client.load_de((outdir.remove_trailing_separator() / "de.bin").string());
+    client.load_dpv((outdir.remove_trailing_separator() / "dpv.bin").string());
+
+    asio::io_service service;
+    tcp::endpoint ep(asio::ip::address::from_string(args["address"].as<string>()), args["port"].as<short>());
+    tcp::socket sock(service);
+
+    Server server(client.get_De(), client.get_pk(), sock, ep);
+    server.set_threads(args["threads"].as<int>());
+    server.set_unlock_cache(args["unlock-cache"].as<size_t>() << 20);
+    server.set_dist_cache(args["dist-cache"].as<size_t>() << 20);
+    set_value_bound(server, args);
+    set_mask_pool(server, args);
+
+    auto pairs = query_pairs(args);
+    size_t lockstep = std::max<size_t>(args["lockstep"].as<size_t>(), 1);
+    double total = 0.0;
+    for (size_t begin = 0; begin < pairs.size(); begin += lockstep)
+    {
+        size_t end = std::min(begin + lockstep, pairs.size());
+        vector<Request> reqs;
+        for (size_t i = begin; i < end; i++)
+        {
+            reqs.push_back(client.give_request(pairs[i].first, pairs[i].second));
+            if (!reqs.back().validity)
+            {
+                cerr << "Invalid query " << pairs[i].first << " -> " << pairs[i].second << endl;
+            }
+        }
+
+        auto query_start = chrono::high_resolution_clock::now();
+        vector<mpz_class> results_enc = server.query_dist_batch(reqs);
+        auto query_end = chrono::high_resolution_clock::now();
+        total += chrono::duration<double>(query_end - query_start).count();
+
+        for (size_t i = 0; i < reqs.size(); i++)
+        {
+            if (!reqs[i].validity) { continue; }
+            ggm_free_constrain(&reqs[i].constrained_key);
+
+            mpz_class enc;
+            JL_decryption(client.get_sk(), client.get_pk(), results_enc[i], enc);
+            cout << pairs[begin + i].first << " -> " << pairs[begin + i].second << ": " << enc.get_str() << endl;
+        }
+    }
+    cout << pairs.size() << " queries in " << total << "s, " << (total > 0 ? pairs.size() / total : 0.0) << " queries/s" << endl;
+    print_unlock_cache_stats(server);
+    print_mask_pool_stats(server);
+    print_dist_cache_stats(server);
 }
 
 void page_rank(cxxopts::ParseResult& args)
@@ -292,7 +781,7 @@ void page_rank(cxxopts::ParseResult& args)
         scaler = SCALE_SHIFT_P;
     }
 
-    client.enc_graph(args["infile"].as<string>(), scaler);
+    client.enc_graph(args["infile"].as<string>(), scaler, args["threads"].as<int>());
     // client.set_graph(args["infile"].as<string>());
     // client.load_dcv((outdir.remove_trailing_separator() / "dcv.bin").string());
     // client.load_de((outdir.remove_trailing_separator() / "de.bin").string());
@@ -303,6 +792,7 @@ void page_rank(cxxopts::ParseResult& args)
     tcp::endpoint ep(asio::ip::address::from_string(args["address"].as<string>()), args["port"].as<short>());
     tcp::socket sock(service);
     Server server(client.get_De(), client.get_pk(), sock, ep);
+    server.set_threads(args["threads"].as<int>());
 
     // Begin works
     // Request reqs = client.give_request("0", "1");
@@ -771,6 +1261,30 @@ void simple_client(cxxopts::ParseResult& args)
     cout << "Quiting.." << endl;
 }
 
+void cache_graph(cxxopts::ParseResult& args)
+{
+    const string& infile = args["infile"].as<string>();
+
+    auto parse_start = chrono::high_resolution_clock::now();
+    EDGE_LIST edges;
+    if (!parse_edge_list(infile, edges, args["threads"].as<int>()))
+    {
+        cerr << "Read graph file failed!" << endl;
+        return;
+    }
+    auto parse_end = chrono::high_resolution_clock::now();
+
+    // build_graph picks it up as long as infile is not changed
+    if (!save_edge_list_cache(edge_list_cache_path(infile), infile, edges))
+    {
+        cerr << "Write edge list cache failed!" << endl;
+        return;
+    }
+
+    cout << edges.names.size() << " vertices, " << edges.src.size() << " edges, parsed in "
+         << chrono::duration<double>(parse_end - parse_start).count() << endl;
+}
+
 void eval_ggm(cxxopts::ParseResult& args)
 {
     // Prepare outdir
@@ -937,8 +1451,12 @@ map<string, void (*) (cxxopts::ParseResult&)> Experiments({
     {"simple_server", simple_server},
     {"simple_test", simple_test},
     {"enc_graph", enc_graph},
+    {"enc_labels", enc_labels},
+    {"cache_graph", cache_graph},
     {"start_proxy", start_proxy},
     {"query_dist", query_dist},
+    {"query_dist_all", query_dist_all},
+    {"query_dist_batch", query_dist_batch},
     {"query_flow", query_flow},
     {"page_rank", page_rank},
     {"eval_ggm", eval_ggm},
@@ -972,6 +1490,23 @@ int main(int argc, char *argv[])
         ("start", "Start point", cxxopts::value<string>())
         ("end", "End point", cxxopts::value<string>())
         ("batch", "Batch size of secure compare", cxxopts::value<int>()->default_value("4"))
+        ("queries", "File of \"start end\" pairs to query in one session", cxxopts::value<string>())
+        ("unlock-cache", "MB of unlocked adjacency the server keeps across queries", cxxopts::value<size_t>()->default_value("0"))
+        ("dist-cache", "MB of query_dist results the server keeps", cxxopts::value<size_t>()->default_value(to_string(DIST_CACHE_DEFAULT_MB)))
+        ("dist-cache-file", "Load the query_dist results from this file and save them back", cxxopts::value<string>())
+        ("max-vertices", "Vertices query_dist_all settles per source, 0 for all", cxxopts::value<size_t>()->default_value("0"))
+        ("max-hops", "Edges from the source query_dist_all expands to, 0 for no limit", cxxopts::value<size_t>()->default_value("0"))
+        ("value-bound", "Longest distance or largest flow a query can see, picks narrower circuits, 0 for SEC_GDB_INF", cxxopts::value<size_t>()->default_value("0"))
+        ("mask-pool", "Blinding masks of each size the server encrypts ahead in the background, 0 for none", cxxopts::value<size_t>()->default_value("0"))
+        ("updates", "File of \"src dest weight\" edges query_dist inserts before the queries", cxxopts::value<string>())
+        ("engine", "Shortest path engine of query_dist, dijkstra, bellman-ford, labels, alt or ch", cxxopts::value<string>()->default_value("dijkstra"))
+        ("landmarks", "Landmarks whose potentials enc_graph --stream encrypts for --engine alt", cxxopts::value<size_t>()->default_value("0"))
+        ("shortcuts", "Add the contraction hierarchy edges to D_e for --engine ch, needs --stream, they are not gated by the proxy and reveal the hierarchy to the server", cxxopts::value<bool>()->default_value("false"))
+        ("lockstep", "Requests query_dist_batch runs side by side", cxxopts::value<size_t>()->default_value("16"))
+        ("threads", "Worker threads for graph parsing, encryption and edge unlocking", cxxopts::value<int>()->default_value("1"))
+        ("stream", "Encrypt a source-sorted graph chunk by chunk into D_e shards", cxxopts::value<bool>()->default_value("false"))
+        ("chunk", "Edges buffered per chunk in stream mode", cxxopts::value<size_t>()->default_value("1048576"))
+        ("shards", "Number of D_e shard files in stream mode", cxxopts::value<int>()->default_value("16"))
         ("h,help", "Print usage")
         ;
     try
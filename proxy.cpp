@@ -33,11 +33,11 @@ void Proxy::inverse(ip::tcp::socket& sock)
     }
 }
 
-void Proxy::compare(ip::tcp::socket& sock, ProtocolDesc& pd)
+void Proxy::compare(ip::tcp::socket& sock, ProtocolDesc& pd, int circuit, int width)
 {
     try
     {
-        secure_compare_remote(pd, this->pk.jl_pk, this->jl_sk, sock);
+        secure_compare_remote(pd, this->pk.jl_pk, this->jl_sk, sock, circuit, width);
     }
     catch (const sec_gdb_network_exception& e)
     {
@@ -47,6 +47,48 @@ void Proxy::compare(ip::tcp::socket& sock, ProtocolDesc& pd)
     }
 }
 
+void Proxy::compare_batch(ip::tcp::socket& sock, int circuit, int width)
+{
+    try
+    {
+        secure_compare_batch_remote(this->pk.jl_pk, this->jl_sk, sock, circuit, width);
+    }
+    catch (const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Secure batch compare remote communication failed!\n"
+                <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Proxy fails to excute batched secure comparsion!");
+    }
+}
+
+void Proxy::min(ip::tcp::socket& sock, int width)
+{
+    try
+    {
+        secure_min_batch_remote(this->pk.jl_pk, this->jl_sk, sock, width);
+    }
+    catch (const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Secure min remote communication failed!\n"
+                <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Proxy fails to excute secure min!");
+    }
+}
+
+void Proxy::sign(ip::tcp::socket& sock, int width)
+{
+    try
+    {
+        secure_sign_batch_remote(this->pk.jl_pk, this->jl_sk, sock, width);
+    }
+    catch (const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Secure sign test remote communication failed!\n"
+                <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Proxy fails to excute secure sign test!");
+    }
+}
+
 void Proxy::multiply(ip::tcp::socket& sock)
 {
     try
@@ -123,11 +165,23 @@ void Proxy::parse_request(ip::tcp::socket sock)
         {
             PROTOCOL_HEAD_TYPE protocol = net_recv_protocol_head(sock);
             log_dbg_fmt("\nProtocol: %02hhx\n", protocol);
-            switch (protocol)
+            switch (protocol & MPC_PROTOCOL_MASK)
             {
                 case MPC_SECURE_COMPARSION:
                     log_dbg("Going to secure comparsion\n");
-                    compare(sock, pd);
+                    compare(sock, pd, protocol_circuit(protocol), protocol_width(protocol));
+                    break;
+                case MPC_SECURE_COMPARSION_BATCH:
+                    log_dbg("Going to batched secure comparsion\n");
+                    compare_batch(sock, protocol_circuit(protocol), protocol_width(protocol));
+                    break;
+                case MPC_SECURE_MIN:
+                    log_dbg("Going to secure min\n");
+                    min(sock, protocol_width(protocol));
+                    break;
+                case MPC_SECURE_SIGN:
+                    log_dbg("Going to secure sign test\n");
+                    sign(sock, protocol_width(protocol));
                     break;
                 case MPC_SECURE_MULTIPLICATION:
                     log_dbg("Going to secure multiplication\n");
@@ -184,12 +238,12 @@ void Proxy::accept()
 }
 
 Proxy::Proxy(ip::tcp::acceptor& acc, io_service& service)
-    : D_pv(), pk(), jl_sk(), service(service), acceptor(std::move(acc))
+    : pk(), jl_sk(), service(service), acceptor(std::move(acc)), D_pv()
 {
 }
 
 Proxy::Proxy(const unordered_map<string, V_ITEM>& D_pv, const PK& pk, const JL_SK& jl_sk,ip::tcp::acceptor& acc, io_service& service)
-    : D_pv(D_pv), pk(pk), jl_sk(jl_sk), service(service), acceptor(std::move(acc))
+    : pk(pk), jl_sk(jl_sk), service(service), acceptor(std::move(acc)), D_pv(D_pv)
 {
 }
 
@@ -1,14 +1,39 @@
 #!/bin/bash
+# Compare the engines of query_dist on the same queries. Each data set has to
+# be encrypted into ./benchmark_result/exp_${i}/ by enc_graph first. The
+# queries are read from ./data/queries/${i}.txt, one "start end" pair per
+# line, which is generated from the data set when it is missing.
+
+# 100 pairs of vertices with out edges of the graph in $1 into $2. The random
+# source is an AES-CTR stream keyed by $3, so the same seed gives the same
+# pairs on every run.
+gen_queries() {
+    awk '!/^[#%]/ && NF >= 3 { print $1 }' "$1" | sort -u \
+        | shuf -r -n 200 --random-source=<(openssl enc -aes-256-ctr -pass pass:"$3" -nosalt < /dev/zero 2> /dev/null) \
+        | paste -d ' ' - - > "$2"
+}
 
 if [ ! -x "./benchmark_result/dist" ]; then
     mkdir "benchmark_result/dist"
 fi
+if [ ! -x "./data/queries" ]; then
+    mkdir -p "./data/queries"
+fi
 for i in 'wiki-Vote' 'email-Enron' 'email-EuAll' 'loc-gowalla_edges' 'com-youtube' 'wiki-Talk'
 do
-    if [ ! -x "./benchmark_result/dist/${i}.xml" ]; then
-        touch "./benchmark_result/dist/${i}.xml"
-    fi
     echo "Data set: "${i}
-    ./a.out "./data/exh/"${i}".data" "./benchmark_result/dist/${i}.xml" "./data/fake/${i}.data"
+    if [ ! -s "./data/queries/${i}.txt" ]; then
+        gen_queries "./data/exh/${i}.data" "./data/queries/${i}.txt" "${i}"
+    fi
+    ./build/main -e start_proxy -o "./benchmark_result/exp_${i}/" > /dev/null &
+    proxy=$!
+    sleep 1
+    for engine in 'dijkstra' 'bellman-ford'
+    do
+        # No distance cache, every query runs its own search.
+        ./build/main -e query_dist --engine ${engine} --dist-cache 0 -i "./data/exh/${i}.data" \
+            -o "./benchmark_result/exp_${i}/" --queries "./data/queries/${i}.txt" > "./benchmark_result/dist/${i}.${engine}.log"
+    done
+    kill ${proxy}
     echo "done!"
-done
\ No newline at end of file
+done
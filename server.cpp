@@ -10,6 +10,9 @@
 #include <boost/heap/fibonacci_heap.hpp>
 #include <boost/asio.hpp>
 #include <cassert>
+#include <cstring>
+#include <fstream>
+#include <openssl/evp.h>
 
 #include "server.hpp"
 
@@ -32,10 +35,12 @@ bool Server::compare(const mpz_class& left, const mpz_class& right, int mode) co
     try
     {
 #ifndef SEC_GDB_WITHOUT_ENCRYPTION
-        net_send_protocol_head(const_cast<boost::asio::ip::tcp::socket&>(this->sock), MPC_SECURE_COMPARSION);
+        net_send_protocol_head(const_cast<boost::asio::ip::tcp::socket&>(this->sock),
+                               protocol_head(MPC_SECURE_COMPARSION, compare_circuit(mode), this->cmp_width));
 #endif
-        rtn = (mode == secure_compare(const_cast<ProtocolDesc&>(this->pd), const_cast<JL_PK&>(this->pk.jl_pk), 
-                        const_cast<mpz_class&>(left), const_cast<mpz_class&>(right), const_cast<boost::asio::ip::tcp::socket&>(this->sock)));
+        rtn = (1 == secure_compare(const_cast<ProtocolDesc&>(this->pd), const_cast<JL_PK&>(this->pk.jl_pk),
+                        const_cast<mpz_class&>(left), const_cast<mpz_class&>(right), const_cast<boost::asio::ip::tcp::socket&>(this->sock),
+                        compare_circuit(mode), this->cmp_width));
     }
     catch (const sec_gdb_network_exception& e)
     {
@@ -47,6 +52,97 @@ bool Server::compare(const mpz_class& left, const mpz_class& right, int mode) co
     return rtn;
 }
 
+vector<bool> Server::compare_batch(const vector<mpz_class>& left, const vector<mpz_class>& right, int mode) const
+{
+    vector<bool> rtn(left.size());
+    const size_t slots = compare_slots(this->cmp_width);
+    for (size_t begin = 0; begin < left.size(); begin += slots)
+    {
+        size_t end = std::min(begin + slots, left.size());
+        vector<mpz_class> chunk_left(left.begin() + begin, left.begin() + end);
+        vector<mpz_class> chunk_right(right.begin() + begin, right.begin() + end);
+        try
+        {
+#ifndef SEC_GDB_WITHOUT_ENCRYPTION
+            net_send_protocol_head(const_cast<boost::asio::ip::tcp::socket&>(this->sock),
+                                   protocol_head(MPC_SECURE_COMPARSION_BATCH, compare_circuit(mode), this->cmp_width));
+#endif
+            vector<int> results = secure_compare_batch(const_cast<JL_PK&>(this->pk.jl_pk), chunk_left, chunk_right,
+                                    const_cast<boost::asio::ip::tcp::socket&>(this->sock), compare_circuit(mode), this->cmp_width);
+            for (size_t i = begin; i < end; i++)
+            {
+                rtn[i] = (1 == results[i - begin]);
+            }
+        }
+        catch (const sec_gdb_network_exception& e)
+        {
+            std::cerr << "Secure batch compare local communication failed!\n"
+                    <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+            throw sec_gdb_global_exception("Server fails to execute batched secure comparsion!");
+        }
+    }
+    return rtn;
+}
+
+bool Server::is_positive(const mpz_class& value) const
+{
+    return this->is_positive_batch(vector<mpz_class>(1, value))[0];
+}
+
+vector<bool> Server::is_positive_batch(const vector<mpz_class>& values) const
+{
+    vector<bool> rtn(values.size());
+    if (values.empty())
+    {
+        return rtn;
+    }
+    try
+    {
+#ifndef SEC_GDB_WITHOUT_ENCRYPTION
+        net_send_protocol_head(const_cast<boost::asio::ip::tcp::socket&>(this->sock),
+                               protocol_head(MPC_SECURE_SIGN, 0, this->cmp_width));
+#endif
+        vector<int> results = secure_sign_batch(const_cast<JL_PK&>(this->pk.jl_pk), values,
+                                const_cast<boost::asio::ip::tcp::socket&>(this->sock), this->cmp_width);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            rtn[i] = (results[i] == COMPARE_HIGHER);
+        }
+    }
+    catch (const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Secure sign test local communication failed!\n"
+                <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Server fails to execute secure sign test!");
+    }
+    return rtn;
+}
+
+void Server::secure_min(const vector<mpz_class>& left, const vector<mpz_class>& right, vector<mpz_class>& min, vector<mpz_class>* selector) const
+{
+    if (left.empty())
+    {
+        min.clear();
+        if (selector != nullptr) { selector->clear(); }
+        return;
+    }
+    try
+    {
+#ifndef SEC_GDB_WITHOUT_ENCRYPTION
+        net_send_protocol_head(const_cast<boost::asio::ip::tcp::socket&>(this->sock),
+                               protocol_head(MPC_SECURE_MIN, 0, this->cmp_width));
+#endif
+        secure_min_batch(const_cast<JL_PK&>(this->pk.jl_pk), const_cast<vector<mpz_class>&>(left), const_cast<vector<mpz_class>&>(right),
+                         const_cast<boost::asio::ip::tcp::socket&>(this->sock), min, selector, this->cmp_width);
+    }
+    catch (const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Secure min local communication failed!\n"
+                <<  "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Server fails to execute secure min!");
+    }
+}
+
 mpz_class Server::multiply(mpz_class& left, mpz_class& right, int scaler)
 {
     mpz_class result;
@@ -110,322 +206,1408 @@ int Server::contact_and_get_ggm_sub_key(GGM& ggm, Subkeys& sub_key, string& P_t)
         {
             ggm_derive(&ggm, &con, &sub_key);
         }
-        ggm_free_constrain(&con);
-    }
-    catch(const sec_gdb_network_exception& e)
-    {
-        std::cerr << "Receiving Constrain occurs error!\n"
-            << "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
-        throw sec_gdb_global_exception("Server fails to derive sub key!");
+        ggm_free_constrain(&con);
+    }
+    catch(const sec_gdb_network_exception& e)
+    {
+        std::cerr << "Receiving Constrain occurs error!\n"
+            << "Error: " << e.get_msg() << " Error code: " << e.get_ec() << endl;
+        throw sec_gdb_global_exception("Server fails to derive sub key!");
+    }
+#endif
+    return ctr;
+}
+
+void Server::recover_masked_edge_info(const u_char* token, NEIGHBORS& out, size_t i) const
+{
+    const u_char* UT_i = token;
+    const u_char* mask = token + KEY_SIZE;
+
+    // Workers share D_e, it is only read here.
+    auto it = this->D_e.find(string((char*)UT_i, KEY_SIZE));
+    assert(it != this->D_e.end());
+
+    if (!unmask_edge_record(it->second, mask, &out.P_v[i * KEY_SIZE], &out.F_1_v[i * KEY_SIZE], out.weight.data(i), CIPHER_LIMBS))
+    {
+        throw sec_gdb_global_exception("Edge weight does not fit in a ciphertext!");
+    }
+}
+
+void Server::unlock_adjacency_vertexes(const string& F_1_u, Subkeys& sub_keys, int ctr, NEIGHBORS& out)
+{
+    EDGE_TOKEN_CTX token_ctx;
+    edge_token_init(token_ctx, (const u_char*)F_1_u.data(), KEY_SIZE);
+
+    out.resize(ctr);
+
+    // Hubs are split over the pool, a vertex of at most one grain is
+    // unlocked on this thread. Each worker derives the tokens of its
+    // range and writes its own slots of out.
+    this->pool->parallel_for((size_t)ctr, 1024, [&](size_t begin, size_t end, int) {
+        u_char tokens[64 * EDGE_TOKEN_SIZE];
+        for (size_t first = begin; first < end; first += 64)
+        {
+            size_t n = std::min((size_t)64, end - first);
+            edge_tokens(token_ctx, sub_keys.keys + first, n, KEY_SIZE, tokens);
+            for (size_t i = 0; i < n; i++)
+            {
+                recover_masked_edge_info(tokens + i * EDGE_TOKEN_SIZE, out, first + i);
+            }
+        }
+    });
+}
+
+const NEIGHBORS& Server::unlock_source(const string& F_1_s, const string& P_s, Constrain& constrained_key, size_t ctr, NEIGHBORS& scratch)
+{
+    // The request carries the counter of the source, so a stale entry is
+    // caught here even without an invalidation.
+    UNLOCKED_ADJ* hit = this->adj_cache.get(P_s);
+    if (hit != nullptr && hit->ctr == ctr)
+    {
+        return hit->neighbors;
+    }
+
+    GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
+    Subkeys sub_keys;
+    ggm_derive(&ggm, &constrained_key, &sub_keys);
+    unlock_adjacency_vertexes(F_1_s, sub_keys, ctr, scratch);
+    ggm_free_keys(&sub_keys);
+
+    this->cache_unlocked(P_s, ctr, scratch);
+    return scratch;
+}
+
+const NEIGHBORS& Server::unlock_vertex(GGM& ggm, const string& P_u, NEIGHBORS& scratch)
+{
+    UNLOCKED_ADJ* hit = this->adj_cache.get(P_u);
+    auto known = this->vertex_ctr.find(P_u);
+    if (hit != nullptr && (known == this->vertex_ctr.end() || known->second == hit->ctr))
+    {
+        return hit->neighbors;
+    }
+
+    Subkeys sub_keys;
+    int ctr = contact_and_get_ggm_sub_key(ggm, sub_keys, const_cast<string&>(P_u));
+    if (ctr < 1)
+    {
+        // Sinks are cached too, it saves their look up round trip.
+        scratch.resize(0);
+    }
+    else
+    {
+        unlock_adjacency_vertexes(this->D_key[P_u], sub_keys, ctr, scratch);
+        ggm_free_keys(&sub_keys);
+    }
+
+    this->cache_unlocked(P_u, (size_t)std::max(ctr, 0), scratch);
+    return scratch;
+}
+
+void Server::cache_unlocked(const string& P_u, size_t ctr, const NEIGHBORS& neighbors)
+{
+    if (!this->adj_cache.enabled())
+    {
+        return;
+    }
+    size_t bytes = sizeof(UNLOCKED_ADJ) + 2 * P_u.size()
+        + neighbors.size() * (2 * KEY_SIZE + CIPHER_LIMBS * sizeof(mp_limb_t));
+    this->adj_cache.put(P_u, UNLOCKED_ADJ{ctr, neighbors}, bytes);
+}
+
+void Server::set_unlock_cache(size_t bytes)
+{
+    this->adj_cache.set_capacity(bytes);
+}
+
+void Server::invalidate_unlock_cache(const string& P_u)
+{
+    this->adj_cache.erase(P_u);
+}
+
+void Server::apply_update(const U_ITEM& update)
+{
+    this->D_e[update.token] = update.record;
+    this->vertex_ctr[update.index] = update.ctr;
+    this->on_graph_update(update.index);
+}
+
+void Server::build_server_graph(string &F_1_s, string &P_s, string & /* P_t */, Constrain &constrained_key, size_t ctr)
+{   
+    // Vertices are interned once they are found, so each one is unlocked once.
+    queue<string> q;
+    vector<uint32_t> src, dest;
+    vector<mpz_class> weight;
+
+    uint32_t s = this->sever_graph.intern(P_s);
+
+    GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
+    NEIGHBORS scratch;
+    const NEIGHBORS& neighbors = unlock_source(F_1_s, P_s, constrained_key, ctr, scratch);
+
+    for (size_t i = 0; i < neighbors.size(); i++)
+    {
+        string P_v_i = neighbors.P(i);
+        mpz_class e_i = neighbors.weight[i];
+
+        if (this->sever_graph.id_of(P_v_i) == CSR_NO_VERTEX)
+        {
+            q.push(P_v_i);
+            this->D_key[P_v_i] = neighbors.F_1(i);
+        }
+        src.push_back(s);
+        dest.push_back(this->sever_graph.intern(P_v_i));
+        weight.push_back(e_i);
+    }
+
+    while(!q.empty())
+    {
+        string P_u = q.front();
+        q.pop();
+
+        const NEIGHBORS& neighbors = unlock_vertex(ggm, P_u, scratch);
+        if (neighbors.size() == 0) {continue;}
+
+        uint32_t u = this->sever_graph.id_of(P_u);
+        for (size_t i = 0; i < neighbors.size(); i++)
+        {
+            string P_v_i = neighbors.P(i);
+            mpz_class e_i = neighbors.weight[i];
+
+            if (this->sever_graph.id_of(P_v_i) == CSR_NO_VERTEX)
+            {
+                q.push(P_v_i);
+                this->D_key[P_v_i] = neighbors.F_1(i);
+            }
+            src.push_back(u);
+            dest.push_back(this->sever_graph.intern(P_v_i));
+            weight.push_back(e_i);
+        }
+    }
+
+    this->sever_graph.assign(src, dest, weight);
+
+    // Reverse edges only open once some flow is pushed back along them.
+    this->arc_open = this->sever_graph.build_residual(this->zero);
+    for (auto& open : this->arc_open)
+    {
+        open = !open;
+    }
+
+    this->caps.assign(this->sever_graph.weights);
+    vector<mpz_class>().swap(this->sever_graph.weights);
+}
+
+bool Server::set_level(string & /* F_1_s */, string &P_s, string &P_t, Constrain & /* constrained_key */, size_t /* ctr */)
+{
+    CSRGraph<mpz_class>& graph = this->sever_graph;
+    uint32_t s = graph.id_of(P_s);
+    uint32_t t = graph.id_of(P_t);
+
+    this->level.assign(graph.num_vertices(), -1);
+    if (s == CSR_NO_VERTEX || t == CSR_NO_VERTEX)
+    {
+        return false;
+    }
+
+    // One BFS layer at a time, the capacities of all open edges leaving a
+    // layer for unlevelled vertices are tested together. Stops with the
+    // layer of t, the later ones are not in any shortest augmenting path.
+    vector<uint32_t> layer(1, s);
+    this->level[s] = 0;
+    for (int depth = 1; !layer.empty() && this->level[t] < 0; depth++)
+    {
+        vector<size_t> cand;
+        vector<mpz_class> left;
+        for (auto u : layer)
+        {
+            for (size_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++)
+            {
+                if (this->arc_open[e] && this->level[graph.targets[e]] < 0)
+                {
+                    cand.push_back(e);
+                    left.push_back(this->caps.get(e));
+                }
+            }
+        }
+
+        vector<bool> positive = is_positive_batch(left);
+
+        vector<uint32_t> next;
+        for (size_t k = 0; k < cand.size(); k++)
+        {
+            uint32_t v = graph.targets[cand[k]];
+            if (positive[k] && this->level[v] < 0)
+            {
+                this->level[v] = depth;
+                next.push_back(v);
+            }
+        }
+        layer.swap(next);
+    }
+
+    return this->level[t] >= 0;
+}
+
+mpz_class Server::augment(uint32_t s, uint32_t t, const mpz_class& gamma)
+{
+    CSRGraph<mpz_class>& graph = this->sever_graph;
+
+    // Arcs before arc[u] are saturated or lead to dead ends, for the whole
+    // phase. Each arc is tested for capacity at most once when it is reached.
+    vector<size_t> arc(graph.offsets.begin(), graph.offsets.end() - 1);
+
+    // The current path, edges and the vertices they leave from.
+    vector<size_t> edges;
+    vector<uint32_t> tails;
+
+    mpz_class flow(this->zero), remaining(gamma);
+    uint32_t u = s;
+    while (true)
+    {
+        if (u == t)
+        {
+            // The bottleneck of the path, gamma included.
+            vector<vector<mpz_class>> groups(1);
+            groups[0].push_back(remaining);
+            for (auto e : edges)
+            {
+                groups[0].push_back(this->caps.get(e));
+            }
+            vector<mpz_class> push;
+            min_of_groups(groups, push);
+
+            for (auto e : edges)
+            {
+                this->caps.homo_sub(this->pk.jl_pk, e, push[0]);
+                this->caps.homo_add(this->pk.jl_pk, graph.pair[e], push[0]);
+                this->arc_open[graph.pair[e]] = 1;
+            }
+            flow = JL_homo_add(this->pk, flow, push[0]);
+            remaining = JL_homo_sub(this->pk, remaining, push[0]);
+
+            // Which edges are saturated now and whether gamma is used up,
+            // in one batch.
+            vector<mpz_class> left;
+            for (auto e : edges)
+            {
+                left.push_back(this->caps.get(e));
+            }
+            left.push_back(remaining);
+            vector<bool> positive = is_positive_batch(left);
+            if (!positive.back())
+            {
+                break;
+            }
+
+            // Back to the tail of the first saturated edge, the bottleneck
+            // is one of them.
+            size_t k = 0;
+            while (k < edges.size() && positive[k]) { k++; }
+            if (k == edges.size())
+            {
+                break;
+            }
+            u = tails[k];
+            arc[u]++;
+            edges.resize(k);
+            tails.resize(k);
+            continue;
+        }
+
+        bool advanced = false;
+        for (; arc[u] < graph.offsets[u + 1]; arc[u]++)
+        {
+            size_t e = arc[u];
+            uint32_t v = graph.targets[e];
+            if (!this->arc_open[e] || this->level[v] != this->level[u] + 1)
+            {
+                continue;
+            }
+            if (!is_positive(this->caps.get(e)))
+            {
+                continue;
+            }
+            edges.push_back(e);
+            tails.push_back(u);
+            u = v;
+            advanced = true;
+            break;
+        }
+        if (advanced)
+        {
+            continue;
+        }
+
+        // No way on from u in this phase.
+        if (u == s)
+        {
+            break;
+        }
+        this->level[u] = -1;
+        u = tails.back();
+        arc[u]++;
+        edges.pop_back();
+        tails.pop_back();
+    }
+
+    return flow;
+}
+
+mpz_class Server::augment_path(string & /* F_1_u */, string &P_u, string &P_t, Constrain & /* constrain */, size_t /* ctr */, mpz_class gamma)
+{
+    uint32_t u = this->sever_graph.id_of(P_u);
+    uint32_t t = this->sever_graph.id_of(P_t);
+    if (u == CSR_NO_VERTEX || t == CSR_NO_VERTEX)
+    {
+        return this->zero;
+    }
+    return this->augment(u, t, gamma);
+}
+
+mpz_class Server::query_flow(string &F_1_s, string &P_s, string &P_t, Constrain &constrained_key, size_t ctr)
+{
+    this->sever_graph.clear();
+    this->D_key.clear();
+
+    this->build_server_graph(F_1_s, P_s, P_t, constrained_key, ctr);
+
+    mpz_class c_qf;
+    JL_encryption(this->pk, 0, c_qf);
+
+    // No flow exceeds the value bound, so it serves as infinity and keeps
+    // the bottleneck inside the width of the min circuit.
+    mpz_class inf, cap = std::min(mpz_class(SEC_GDB_INF), this->value_bound);
+    JL_encryption(this->pk, cap, inf);
+
+    while(set_level(F_1_s, P_s, P_t, constrained_key, ctr))
+    {
+        mpz_class tmp = augment_path(F_1_s, P_s, P_t, constrained_key, ctr, inf);
+        c_qf = JL_homo_add(this->pk, c_qf, tmp);
+    }
+
+    return c_qf;
+}
+
+static CACHE_ITEM dist_cache_key(const string& P_s, const string& P_t)
+{
+    CACHE_ITEM key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.src, P_s.data(), std::min(P_s.size(), (size_t)KEY_SIZE));
+    memcpy(key.dest, P_t.data(), std::min(P_t.size(), (size_t)KEY_SIZE));
+    return key;
+}
+
+void Server::cache_dist(const CACHE_ITEM& key, const mpz_class& dist)
+{
+    if (!this->cache.enabled())
+    {
+        return;
+    }
+    size_t bytes = sizeof(CACHE_ITEM) + sizeof(mpz_class) + mpz_size(dist.get_mpz_t()) * sizeof(mp_limb_t);
+    this->cache.put(key, dist, bytes);
+    g_s_cache_size = this->cache.bytes();
+}
+
+void Server::set_dist_cache(size_t bytes)
+{
+    this->cache.set_capacity(bytes);
+    g_s_cache_size = this->cache.bytes();
+}
+
+void Server::invalidate_dist_cache()
+{
+    this->cache.clear();
+    g_s_cache_size = 0;
+}
+
+// File layout: magic, KEY_SIZE, the digest of dist_cache_digest, then per
+// entry P_s, P_t, the size of the distance and its raw bytes, from the
+// least recently used entry on.
+static const char DIST_CACHE_MAGIC[8] = {'S', 'G', 'D', 'B', 'Q', 'D', 'C', '2'};
+
+/**
+ * SHA-256 of the public key and of D_e, the distances of a cache only hold
+ * for the graph and key they were computed under. The entries of D_e are
+ * hashed one by one and xored, so the order of the map does not matter.
+*/
+static void dist_cache_digest(const PK& pk, const unordered_map<string, string>& D_e, u_char out[SHA256_DIGEST_LENGTH])
+{
+    u_char entries[SHA256_DIGEST_LENGTH] = {0};
+    u_char entry[SHA256_DIGEST_LENGTH];
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    for (auto& item : D_e)
+    {
+        EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+        EVP_DigestUpdate(ctx, item.first.data(), item.first.size());
+        EVP_DigestUpdate(ctx, item.second.data(), item.second.size());
+        EVP_DigestFinal_ex(ctx, entry, nullptr);
+        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) { entries[i] ^= entry[i]; }
+    }
+
+    uint64_t num = D_e.size();
+    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    for (const mpz_class* value : {&pk.jl_pk.N, &pk.jl_pk.y, &pk.jl_pk.k})
+    {
+        string digits = value->get_str(16);
+        EVP_DigestUpdate(ctx, digits.data(), digits.size() + 1);
+    }
+    EVP_DigestUpdate(ctx, &num, sizeof(num));
+    EVP_DigestUpdate(ctx, entries, sizeof(entries));
+    EVP_DigestFinal_ex(ctx, out, nullptr);
+    EVP_MD_CTX_free(ctx);
+}
+
+bool Server::save_dist_cache(const string& path) const
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if (out.fail())
+    {
+        cerr << "Open " << path << " failed!" << endl;
+        return false;
+    }
+
+    uint32_t key_size = KEY_SIZE;
+    u_char digest[SHA256_DIGEST_LENGTH];
+    dist_cache_digest(this->pk, this->D_e, digest);
+    out.write(DIST_CACHE_MAGIC, sizeof(DIST_CACHE_MAGIC));
+    out.write((const char*)&key_size, sizeof(key_size));
+    out.write((const char*)digest, sizeof(digest));
+
+    vector<u_char> raw;
+    this->cache.for_each([&](const CACHE_ITEM& key, const mpz_class& dist, size_t) {
+        raw.resize(mpz_sizeinbase(dist.get_mpz_t(), 256));
+        uint32_t size = (uint32_t)get_mpz_raw(raw.data(), const_cast<mpz_ptr>(dist.get_mpz_t()));
+        out.write((const char*)&key, sizeof(key));
+        out.write((const char*)&size, sizeof(size));
+        out.write((const char*)raw.data(), size);
+    });
+    return !out.fail();
+}
+
+bool Server::load_dist_cache(const string& path)
+{
+    ifstream in(path, ios::binary);
+    if (in.fail())
+    {
+        return false;
+    }
+
+    char magic[sizeof(DIST_CACHE_MAGIC)];
+    uint32_t key_size = 0;
+    in.read(magic, sizeof(magic));
+    in.read((char*)&key_size, sizeof(key_size));
+    if (in.fail() || memcmp(magic, DIST_CACHE_MAGIC, sizeof(magic)) != 0 || key_size != KEY_SIZE)
+    {
+        cerr << path << " is not a distance cache of this build!" << endl;
+        return false;
+    }
+
+    u_char digest[SHA256_DIGEST_LENGTH], expected[SHA256_DIGEST_LENGTH];
+    in.read((char*)digest, sizeof(digest));
+    dist_cache_digest(this->pk, this->D_e, expected);
+    if (in.fail() || memcmp(digest, expected, sizeof(digest)) != 0)
+    {
+        cerr << path << " was saved for another key or graph!" << endl;
+        return false;
+    }
+
+    CACHE_ITEM key;
+    uint32_t size;
+    vector<u_char> raw;
+    while (in.read((char*)&key, sizeof(key)) && in.read((char*)&size, sizeof(size)))
+    {
+        raw.resize(size);
+        if (!in.read((char*)raw.data(), size))
+        {
+            cerr << path << " is truncated!" << endl;
+            return false;
+        }
+        mpz_class dist;
+        set_mpz_raw(dist.get_mpz_t(), size, raw.data());
+        this->cache_dist(key, dist);
+    }
+    return true;
+}
+
+bool Server::shortest_paths(const string &F_1_s, const string &P_s, const string *P_t, Constrain &constrained_key, size_t ctr,
+                            size_t max_settled, size_t max_hops, vector<string> &settled, const ALT_TARGET *alt,
+                            size_t *exact)
+{
+    FibHeapCompare cmp(*this); // Initializing custom compare function.
+    FIBO_HEAP fh(cmp); // Initializing a fibonacci heap.
+
+    unordered_map<string, FIBO_HEAP::handle_type> heap_handlers; // Use a hash table to access the vertex added into heap.
+    unordered_set<string> chosen_vertices;
+    // Fewest edges on any path found to each vertex.
+    unordered_map<string, size_t> hops;
+
+    this->xi.clear();
+    this->D_key.clear();
+
+    // The reason of these steppes is for preventing source vertex from being chosen again.
+    xi[P_s] = this->zero;
+    hops[P_s] = 0;
+    heap_handlers[P_s] = fh.push(HEAP_ITEM{P_s, this->zero});
+    fh.pop();
+    chosen_vertices.emplace(P_s); //Important!
+
+    // Heap key of P_v at distance dist. The potentials are feasible, so a
+    // vertex is still settled at its final distance.
+    unordered_map<string, mpz_class> potential;
+    auto heap_key = [&](const string& P_v, const mpz_class& dist) -> mpz_class {
+        if (alt == nullptr)
+        {
+            return dist;
+        }
+        auto it = potential.find(P_v);
+        if (it == potential.end())
+        {
+            mpz_class pot;
+            // Only vertices added after the landmarks miss theirs.
+            if (!unlock_landmark(D_key[P_v], alt->dir, alt->j, pot)) { pot = this->zero; }
+            it = potential.emplace(P_v, pot).first;
+        }
+        return JL_homo_add(this->pk, dist, it->second);
+    };
+
+    // Relax all out edges of P_u. A vertex met for the first time takes its
+    // distance as is. The others take min(xi[P_u] + e_i, xi[P_v_i]) from one
+    // secure min for all of them, so no branch waits on a revealed bit.
+    auto relax = [&](const string& P_u, const NEIGHBORS& neighbors) {
+        vector<RELAX_ITEM> items;
+        for (size_t i = 0; i < neighbors.size(); i++)
+        {
+            string P_v_i = neighbors.P(i);
+            mpz_class e_i = neighbors.weight[i];
+            D_key[P_v_i] = neighbors.F_1(i);
+            if (chosen_vertices.find(P_v_i) != chosen_vertices.end())
+            {
+                continue;
+            }
+
+            mpz_class tmp(JL_homo_add(this->pk, xi[P_u], e_i));
+            auto hop = hops.find(P_v_i);
+            if (hop == hops.end() || hops[P_u] + 1 < hop->second)
+            {
+                hops[P_v_i] = hops[P_u] + 1;
+            }
+            if (xi.find(P_v_i) == xi.end())
+            {
+                xi[P_v_i] = tmp;
+                heap_handlers[P_v_i] = fh.push(HEAP_ITEM{P_v_i, heap_key(P_v_i, tmp)});
+                continue;
+            }
+            items.push_back(RELAX_ITEM{P_v_i, tmp});
+        }
+
+        // Parallel edges to the same vertex wait for the next pass.
+        while (!items.empty())
+        {
+            unordered_set<string> in_pass;
+            vector<RELAX_ITEM> pass, later;
+            vector<mpz_class> left, right, best;
+            for (auto& item : items)
+            {
+                if (!in_pass.insert(item.P_v).second)
+                {
+                    later.push_back(std::move(item));
+                    continue;
+                }
+                left.push_back(item.dist);
+                right.push_back(xi[item.P_v]);
+                pass.push_back(std::move(item));
+            }
+
+            secure_min(left, right, best);
+            for (size_t k = 0; k < pass.size(); k++)
+            {
+                const string& P_v = pass[k].P_v;
+                xi[P_v] = best[k];
+                // The distance never grows, it is an increase of priority.
+                fh.increase(heap_handlers[P_v], HEAP_ITEM{P_v, heap_key(P_v, best[k])});
+            }
+            items.swap(later);
+        }
+    };
+
+    GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
+    NEIGHBORS scratch;
+    relax(P_s, unlock_source(F_1_s, P_s, constrained_key, ctr, scratch));
+
+    bool complete = true;
+    if (exact != nullptr) { *exact = 0; }
+    while(!fh.empty())
+    {
+        if (max_settled != 0 && settled.size() >= max_settled)
+        {
+            return false;
+        }
+
+        HEAP_ITEM hi = fh.top();
+        fh.pop();
+        chosen_vertices.emplace(hi.vertex);
+
+        // xi of a settled vertex is final, later queries from P_s reuse it.
+        // Once the hop budget left a vertex unexpanded, the vertices after
+        // it may miss shorter paths through it and stay out of the cache.
+        string &P_u = hi.vertex;
+        settled.push_back(P_u);
+        if (complete)
+        {
+            this->cache_dist(dist_cache_key(P_s, P_u), xi[P_u]);
+            if (exact != nullptr) { *exact = settled.size(); }
+        }
+        if (P_t != nullptr && P_u == *P_t)
+        {
+            return true;
+        }
+
+        // Vertices at the hop budget are settled but not expanded.
+        if (max_hops != 0 && hops[P_u] >= max_hops)
+        {
+            complete = false;
+            continue;
+        }
+
+        relax(P_u, unlock_vertex(ggm, P_u, scratch));
+    }
+    return complete;
+}
+
+mpz_class Server::query_dist(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr, int engine)
+{
+    CACHE_ITEM cache_tmp = dist_cache_key(P_s, P_t);
+    mpz_class* cached = this->cache.get(cache_tmp);
+    if (cached != nullptr)
+    {
+        g_s_use_cache++;
+        return *cached;
+    }
+
+    if (engine == DIST_ENGINE_BELLMAN_FORD)
+    {
+        return query_dist_bf(F_1_s, P_s, P_t, constrained_key, ctr);
+    }
+
+    vector<string> settled;
+    shortest_paths(F_1_s, P_s, &P_t, constrained_key, ctr, 0, 0, settled);
+    if (!settled.empty() && settled.back() == P_t)
+    {
+        return xi[P_t];
+    }
+
+    // P_t can not be reached.
+    mpz_class c_qd;
+    JL_encryption(this->pk, 0, c_qd);
+    this->cache_dist(cache_tmp, c_qd);
+    return c_qd;
+}
+
+bool Server::unlock_landmark(const string& F_1_v, char dir, uint32_t j, mpz_class& out) const
+{
+    EDGE_TOKEN_CTX ctx;
+    edge_token_init(ctx, (const u_char*)F_1_v.data(), KEY_SIZE);
+
+    u_char token[EDGE_TOKEN_SIZE];
+    label_token(ctx, dir, j, token);
+    auto it = this->D_a.find(string((char*)token, KEY_SIZE));
+    if (it == this->D_a.end())
+    {
+        return false;
+    }
+    vector<u_char> raw(it->second.size());
+    masking(it->second.data(), raw.size(), token + KEY_SIZE, KEY_SIZE, raw.data());
+    set_mpz_raw(out.get_mpz_t(), raw.size(), raw.data());
+    return true;
+}
+
+bool Server::pick_landmark(const string& F_1_s, const string& F_1_t, ALT_TARGET& alt) const
+{
+    // The bound of a candidate is pot(s) - pot(t), for both directions.
+    vector<ALT_TARGET> cands;
+    vector<mpz_class> pot_s, pot_t;
+    for (char dir : {LANDMARK_FROM, LANDMARK_TO})
+    {
+        mpz_class x_s, x_t;
+        for (uint32_t j = 0; unlock_landmark(F_1_s, dir, j, x_s) && unlock_landmark(F_1_t, dir, j, x_t); j++)
+        {
+            cands.push_back(ALT_TARGET{dir, j});
+            pot_s.push_back(x_s);
+            pot_t.push_back(x_t);
+        }
+    }
+    if (cands.empty())
+    {
+        return false;
+    }
+
+    // pot_s[a] - pot_t[a] > pot_s[b] - pot_t[b] is compared as
+    // pot_s[a] + pot_t[b] > pot_s[b] + pot_t[a], nothing goes negative.
+    while (cands.size() > 1)
+    {
+        vector<mpz_class> left, right;
+        for (size_t a = 0; a + 1 < cands.size(); a += 2)
+        {
+            left.push_back(JL_homo_add(this->pk, pot_s[a], pot_t[a + 1]));
+            right.push_back(JL_homo_add(this->pk, pot_s[a + 1], pot_t[a]));
+        }
+        vector<bool> higher = compare_batch(left, right, COMPARE_HIGHER);
+
+        size_t n = 0;
+        for (size_t a = 0; a + 1 < cands.size(); a += 2)
+        {
+            size_t win = higher[a / 2] ? a : a + 1;
+            cands[n] = cands[win];
+            swap(pot_s[n], pot_s[win]);
+            swap(pot_t[n], pot_t[win]);
+            n++;
+        }
+        if (cands.size() % 2 == 1)
+        {
+            cands[n] = cands.back();
+            swap(pot_s[n], pot_s.back());
+            swap(pot_t[n], pot_t.back());
+            n++;
+        }
+        cands.resize(n);
+        pot_s.resize(n);
+        pot_t.resize(n);
     }
-#endif
-    return ctr;
+    alt = cands[0];
+    return true;
 }
 
-void Server::recover_masked_edge_info(u_char* F_1_u, u_char* sub_key, string& P_v, string& F_1_v, mpz_class& ei)
+mpz_class Server::query_dist_alt(std::string &F_1_s, std::string &P_s, const std::string &F_1_t, std::string &P_t, Constrain &constrained_key, size_t ctr)
 {
-    u_char UT_i[KEY_SIZE];
-    u_char mask[KEY_SIZE];
+    CACHE_ITEM cache_tmp = dist_cache_key(P_s, P_t);
+    mpz_class* cached = this->cache.get(cache_tmp);
+    if (cached != nullptr)
+    {
+        g_s_use_cache++;
+        return *cached;
+    }
 
-    H_1(F_1_u, KEY_SIZE, sub_key, KEY_SIZE, UT_i);
-    H_2(F_1_u, KEY_SIZE, sub_key, KEY_SIZE, mask);
+    ALT_TARGET alt;
+    bool goal_directed = pick_landmark(F_1_s, F_1_t, alt);
 
-    string UT_i_str((char*)UT_i, KEY_SIZE);
-    assert(this->D_e.find(UT_i_str) != this->D_e.end());
-    
-    string& masked_ciph = this->D_e[UT_i_str];
-    u_char ciph_i[masked_ciph.size()];
-    masking(masked_ciph.c_str(), masked_ciph.length(), mask, sizeof(mask), ciph_i);
+    vector<string> settled;
+    shortest_paths(F_1_s, P_s, &P_t, constrained_key, ctr, 0, 0, settled, goal_directed ? &alt : nullptr);
+    if (!settled.empty() && settled.back() == P_t)
+    {
+        return xi[P_t];
+    }
 
-    P_v = string((char*)ciph_i, KEY_SIZE);
-    F_1_v = string((char*)(ciph_i + KEY_SIZE), KEY_SIZE);
-    set_mpz_raw(ei.get_mpz_t(), sizeof(ciph_i) - 2 * KEY_SIZE, ciph_i + 2 * KEY_SIZE);
+    // P_t can not be reached.
+    mpz_class c_qd;
+    JL_encryption(this->pk, 0, c_qd);
+    this->cache_dist(cache_tmp, c_qd);
+    return c_qd;
 }
 
-vector<tuple<string, string, mpz_class>> Server::unlock_adjacency_vertexes(string& F_1_u, Subkeys& sub_keys, int ctr)
+void Server::unlock_labels(const string& F_1_v, char dir, vector<pair<string, mpz_class>>& out) const
 {
-    vector<tuple<string, string, mpz_class>> rtn;
-    u_char* F_1_u_char = (u_char*)F_1_u.c_str();
-    for (int i = 0; i < ctr; i ++)
+    EDGE_TOKEN_CTX ctx;
+    edge_token_init(ctx, (const u_char*)F_1_v.data(), KEY_SIZE);
+
+    u_char token[EDGE_TOKEN_SIZE];
+    u_char tag[KEY_SIZE], unused[KEY_SIZE];
+    mpz_class dist;
+    // The list ends at the first token that is not in D_l.
+    for (uint32_t i = 0; ; i++)
     {
-        string P_vi, F_1_vi;
-        mpz_class ei;
-        // if (F_1_u[0] == '2')
-        // {
-        //     for (int idx = 0; idx < KEY_SIZE; idx ++)
-        //         printf("%2hhx ", sub_keys.keys[i][idx]);
-        //     printf("\n");
-        // }
-        recover_masked_edge_info(F_1_u_char, (u_char*)sub_keys.keys[i], P_vi, F_1_vi, ei);
-        rtn.push_back(std::make_tuple(P_vi, F_1_vi, ei));
+        label_token(ctx, dir, i, token);
+        auto it = this->D_l.find(string((char*)token, KEY_SIZE));
+        if (it == this->D_l.end())
+        {
+            break;
+        }
+        unmask_edge_record(it->second, token + KEY_SIZE, tag, unused, dist.get_mpz_t());
+        out.emplace_back(string((char*)tag, KEY_SIZE), dist);
     }
-    return rtn;
 }
 
-void Server::build_server_graph(string &F_1_s, string &P_s, string &P_t, Constrain &constrained_key, size_t ctr)
-{   
-    // vertces
-    unordered_set<string> accessed_vertces;
-    queue<string> q;
-
-    accessed_vertces.emplace(P_s);
+mpz_class Server::query_dist_label(const string &F_1_s, const string &P_s, const string &F_1_t, const string &P_t)
+{
+    CACHE_ITEM cache_tmp = dist_cache_key(P_s, P_t);
+    mpz_class* cached = this->cache.get(cache_tmp);
+    if (cached != nullptr)
+    {
+        g_s_use_cache++;
+        return *cached;
+    }
 
-    GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
-    Subkeys sub_key;
+    vector<pair<string, mpz_class>> out_s, in_t;
+    unlock_labels(F_1_s, HUB_LABEL_OUT, out_s);
+    unlock_labels(F_1_t, HUB_LABEL_IN, in_t);
 
-    ggm_derive(&ggm, &constrained_key, &sub_key);
+    unordered_map<string, const mpz_class*> hubs;
+    for (auto& each : out_s)
+    {
+        hubs[each.first] = &each.second;
+    }
 
-    auto neighbors = unlock_adjacency_vertexes (F_1_s, sub_key, ctr);
+    // d(s, h) + d(h, t) for every hub h in common.
+    vector<mpz_class> sums;
+    for (auto& each : in_t)
+    {
+        auto it = hubs.find(each.first);
+        if (it != hubs.end())
+        {
+            sums.push_back(JL_homo_add(this->pk, *it->second, each.second));
+        }
+    }
 
-    for (auto each : neighbors)
+    mpz_class c_qd;
+    if (sums.empty())
     {
-        string& P_v_i = std::get<0>(each);
-        string& F_1_vi = std::get<1>(each);
-        mpz_class& e_i = std::get<2>(each);
+        // P_t can not be reached.
+        JL_encryption(this->pk, 0, c_qd);
+        this->cache_dist(cache_tmp, c_qd);
+        return c_qd;
+    }
 
-        this->sever_graph.add_edge(P_s, P_v_i, e_i);
+    vector<vector<mpz_class>> groups(1);
+    groups[0].swap(sums);
+    vector<mpz_class> best;
+    secure_min_of_groups(groups, best);
 
-        q.push(P_v_i);
-        this->D_key[P_v_i] = F_1_vi;
-    }
+    c_qd = best[0];
+    this->cache_dist(cache_tmp, c_qd);
+    return c_qd;
+}
 
-    ggm_free_keys(&sub_key);
+void Server::unlock_ch_edges(const string& F_1_u, char dir, NEIGHBORS& out) const
+{
+    EDGE_TOKEN_CTX ctx;
+    edge_token_init(ctx, (const u_char*)F_1_u.data(), KEY_SIZE);
 
-    while(!q.empty())
+    out.resize(0);
+    u_char token[EDGE_TOKEN_SIZE];
+    // The list ends at the first token that is not in D_e.
+    for (uint32_t i = 0; ; i++)
     {
-        string P_u = q.front();
-        q.pop();
-        accessed_vertces.emplace(P_u);
-
-        Subkeys sub_keys;
-        int ctr_inwhile = contact_and_get_ggm_sub_key(ggm, sub_keys, P_u);
+        label_token(ctx, dir, i, token);
+        if (this->D_e.find(string((char*)token, KEY_SIZE)) == this->D_e.end())
+        {
+            break;
+        }
+        out.resize(i + 1);
+        recover_masked_edge_info(token, out, i);
+    }
+}
 
-        if (ctr_inwhile < 1) {continue;}
+void Server::upward_search(const string& F_1_s, const string& P_s, char dir, unordered_map<string, mpz_class>& dist)
+{
+    // In edges of every vertex above P_s, found breadth first.
+    unordered_map<string, vector<pair<string, mpz_class>>> preds;
+    unordered_map<string, vector<string>> succs;
+    vector<pair<string, string>> todo;
+    todo.emplace_back(P_s, F_1_s);
+    preds[P_s];
+
+    NEIGHBORS neighbors;
+    for (size_t k = 0; k < todo.size(); k++)
+    {
+        string P_u = todo[k].first;
+        unlock_ch_edges(todo[k].second, dir, neighbors);
+        for (size_t i = 0; i < neighbors.size(); i++)
+        {
+            string P_v = neighbors.P(i);
+            if (preds.find(P_v) == preds.end())
+            {
+                todo.emplace_back(P_v, neighbors.F_1(i));
+            }
+            preds[P_v].emplace_back(P_u, neighbors.weight[i]);
+            succs[P_u].push_back(P_v);
+        }
+    }
 
-        auto neighbors = unlock_adjacency_vertexes(this->D_key[P_u], sub_keys, ctr_inwhile);
+    // A vertex joins a layer once all its in edges are from settled ones.
+    unordered_map<string, size_t> waiting;
+    for (auto& each : preds)
+    {
+        waiting[each.first] = each.second.size();
+    }
 
-        for (auto each : neighbors)
+    dist.clear();
+    dist[P_s] = this->zero;
+    vector<string> layer(1, P_s);
+    while (!layer.empty())
+    {
+        vector<string> next;
+        for (auto& P_u : layer)
         {
-            string& P_v_i = std::get<0>(each);
-            string& F_1_vi = std::get<1>(each);
-            mpz_class& e_i = std::get<2>(each);
+            for (auto& P_v : succs[P_u])
+            {
+                if (--waiting[P_v] == 0) { next.push_back(P_v); }
+            }
+        }
 
-            this->sever_graph.add_edge(P_u, P_v_i, e_i);
-            if (accessed_vertces.find(P_v_i) == accessed_vertces.end())
+        vector<vector<mpz_class>> groups(next.size());
+        for (size_t k = 0; k < next.size(); k++)
+        {
+            for (auto& pred : preds[next[k]])
             {
-                q.push(P_v_i);
-                this->D_key[P_v_i] = F_1_vi;
+                groups[k].push_back(JL_homo_add(this->pk, dist[pred.first], pred.second));
             }
         }
-        ggm_free_keys(&sub_keys);
+        vector<mpz_class> best;
+        secure_min_of_groups(groups, best);
+        for (size_t k = 0; k < next.size(); k++)
+        {
+            dist[next[k]] = best[k];
+        }
+        layer.swap(next);
     }
 }
 
-bool Server::set_level(string &F_1_s, string &P_s, string &P_t, Constrain &constrained_key, size_t ctr)
+mpz_class Server::query_dist_ch(const string &F_1_s, const string &P_s, const string &F_1_t, const string &P_t)
 {
-    queue<string> q;
+    CACHE_ITEM cache_tmp = dist_cache_key(P_s, P_t);
+    mpz_class* cached = this->cache.get(cache_tmp);
+    if (cached != nullptr)
+    {
+        g_s_use_cache++;
+        return *cached;
+    }
 
-    this->level.clear();
-    this->level[P_s] = 0;
+    unordered_map<string, mpz_class> forward, backward;
+    upward_search(F_1_s, P_s, CH_UP, forward);
+    upward_search(F_1_t, P_t, CH_DOWN, backward);
 
-    q.push(P_s);
+    // d(s, v) + d(v, t) for every vertex both searches reach.
+    vector<vector<mpz_class>> meet(1);
+    for (auto& each : forward)
+    {
+        auto it = backward.find(each.first);
+        if (it != backward.end())
+        {
+            meet[0].push_back(JL_homo_add(this->pk, each.second, it->second));
+        }
+    }
 
-    while(!q.empty())
+    mpz_class c_qd;
+    if (meet[0].empty())
     {
-        string P_u = q.front();
-        q.pop();
+        // P_t can not be reached.
+        JL_encryption(this->pk, 0, c_qd);
+        this->cache_dist(cache_tmp, c_qd);
+        return c_qd;
+    }
 
-        if (P_u == P_t)
+    vector<mpz_class> best;
+    secure_min_of_groups(meet, best);
+    c_qd = best[0];
+    this->cache_dist(cache_tmp, c_qd);
+    return c_qd;
+}
+
+void Server::min_of_groups(vector<vector<mpz_class>>& groups, vector<mpz_class>& out) const
+{
+    // Each round halves every group, the pairs of all groups share the batches.
+    while (true)
+    {
+        vector<mpz_class> left, right;
+        for (auto& group : groups)
         {
-            return true;
+            for (size_t i = 0; i + 1 < group.size(); i += 2)
+            {
+                left.push_back(group[i]);
+                right.push_back(group[i + 1]);
+            }
         }
-        
-        size_t current_level = this->level[P_u];
-        for (Edge<mpz_class> &e : this->sever_graph.adjacency_list[this->sever_graph.vertices[P_u]])
+        if (left.empty())
+        {
+            break;
+        }
+
+        vector<bool> lower = compare_batch(left, right, COMPARE_LOWER);
+        size_t k = 0;
+        for (auto& group : groups)
         {
-            if (this->level.find(e.dest.name) == this->level.end() 
-                    && compare(e.weight, this->zero, COMPARE_HIGHER))
+            size_t n = 0;
+            for (size_t i = 0; i + 1 < group.size(); i += 2, k++)
             {
-                q.push(e.dest.name);
-                this->level.emplace(e.dest.name, current_level + 1);
+                swap(group[n++], lower[k] ? group[i] : group[i + 1]);
             }
+            if (group.size() % 2 == 1)
+            {
+                swap(group[n++], group.back());
+            }
+            group.resize(n);
         }
     }
 
-    return (this->level.find(P_t) == this->level.end()) ? false : true;
-}
-
-mpz_class Server::augment_path(string &F_1_u, string &P_u, string &P_t, Constrain &constrain, size_t ctr, mpz_class gamma)
-{
-    mpz_class all_cap(this->zero);
-    if (P_u == P_t)
+    out.resize(groups.size());
+    for (size_t i = 0; i < groups.size(); i++)
     {
-        return gamma;
+        if (!groups[i].empty()) { out[i] = groups[i][0]; }
     }
+}
 
-    size_t cur_level = this->level[P_u];
-
-    for (Edge<mpz_class> &e : this->sever_graph.adjacency_list[this->sever_graph.vertices[P_u]])
+void Server::secure_min_of_groups(vector<vector<mpz_class>>& groups, vector<mpz_class>& out) const
+{
+    // Each round halves every group, the pairs of all groups go in one
+    // secure min.
+    while (true)
     {
-        mpz_class local_cap;
-        local_cap = JL_homo_sub(this->pk, gamma, all_cap);
-        if (this->level.find(e.dest.name) != this->level.end() 
-            && this->level[e.dest.name] == cur_level + 1)
+        vector<mpz_class> left, right, min;
+        for (auto& group : groups)
+        {
+            for (size_t i = 0; i + 1 < group.size(); i += 2)
+            {
+                left.push_back(group[i]);
+                right.push_back(group[i + 1]);
+            }
+        }
+        if (left.empty())
         {
-            mpz_class tmp = this->augment_path(this->D_key[e.dest.name], e.dest.name, P_t, constrain, e.dest.out_degree,
-                                               compare(local_cap, e.weight, COMPARE_LOWER) ? local_cap : e.weight);
+            break;
+        }
 
-            auto rev_edge = this->sever_graph.find_edge(e.dest, e.src);
-            if (rev_edge == this->sever_graph.adjacency_list[e.dest].end()) // Cannot find the edge.
+        secure_min(left, right, min);
+        size_t k = 0;
+        for (auto& group : groups)
+        {
+            size_t n = 0;
+            for (size_t i = 0; i + 1 < group.size(); i += 2, k++)
             {
-                this->sever_graph.add_edge(e.dest.name, e.src.name, tmp);
+                swap(group[n++], min[k]);
             }
-            else
+            if (group.size() % 2 == 1)
             {
-                rev_edge->weight = JL_homo_add(this->pk, rev_edge->weight, tmp);
+                swap(group[n++], group.back());
             }
-
-            all_cap = JL_homo_add(this->pk, all_cap, tmp);
-            e.weight = JL_homo_sub(this->pk, e.weight, tmp);
+            group.resize(n);
         }
     }
 
-    return all_cap;
+    out.resize(groups.size());
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        if (!groups[i].empty()) { out[i] = groups[i][0]; }
+    }
 }
 
-mpz_class Server::query_flow(string &F_1_s, string &P_s, string &P_t, Constrain &constrained_key, size_t ctr)
+mpz_class Server::query_dist_bf(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr)
 {
-    this->sever_graph.clear();
+    this->xi.clear();
     this->D_key.clear();
+    xi[P_s] = this->zero;
 
-    this->build_server_graph(F_1_s, P_s, P_t, constrained_key, ctr);
+    GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
+    NEIGHBORS scratch;
 
-    mpz_class c_qf;
-    JL_encryption(this->pk, 0, c_qf);
+    // Vertices whose distance dropped in the last round, only their out
+    // edges can lower another distance in this one.
+    vector<string> frontier{P_s};
+    while (!frontier.empty())
+    {
+        // Candidate distances by vertex, in the order vertices show up.
+        unordered_map<string, size_t> slot_of;
+        vector<string> order;
+        vector<vector<mpz_class>> candidates;
+        for (auto& P_u : frontier)
+        {
+            const NEIGHBORS& neighbors = (P_u == P_s) ? unlock_source(F_1_s, P_s, constrained_key, ctr, scratch)
+                                                      : unlock_vertex(ggm, P_u, scratch);
+            const mpz_class xi_u = xi[P_u];
+            for (size_t i = 0; i < neighbors.size(); i++)
+            {
+                string P_v_i = neighbors.P(i);
+                if (P_v_i == P_s)
+                {
+                    continue;
+                }
+                D_key[P_v_i] = neighbors.F_1(i);
 
-    mpz_class inf;
-    JL_encryption(this->pk, SEC_GDB_INF, inf);
+                auto it = slot_of.find(P_v_i);
+                if (it == slot_of.end())
+                {
+                    it = slot_of.emplace(P_v_i, order.size()).first;
+                    order.push_back(P_v_i);
+                    candidates.emplace_back();
+                }
+                candidates[it->second].push_back(JL_homo_add(this->pk, xi_u, neighbors.weight[i]));
+            }
+        }
 
-    while(set_level(F_1_s, P_s, P_t, constrained_key, ctr))
-    {
-        mpz_class tmp = augment_path(F_1_s, P_s, P_t, constrained_key, ctr, inf);
-        c_qf = JL_homo_add(this->pk, c_qf, tmp);
+        vector<mpz_class> best;
+        min_of_groups(candidates, best);
+
+        // A vertex seen for the first time takes its candidate, the others
+        // only if it is lower than what they have.
+        frontier.clear();
+        vector<string> known;
+        vector<mpz_class> left, right;
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            auto it = xi.find(order[k]);
+            if (it == xi.end())
+            {
+                xi[order[k]] = best[k];
+                frontier.push_back(order[k]);
+            }
+            else
+            {
+                known.push_back(order[k]);
+                left.push_back(best[k]);
+                right.push_back(it->second);
+            }
+        }
+
+        vector<bool> lower = compare_batch(left, right, COMPARE_LOWER);
+        for (size_t k = 0; k < known.size(); k++)
+        {
+            if (lower[k])
+            {
+                xi[known[k]] = left[k];
+                frontier.push_back(known[k]);
+            }
+        }
     }
 
-    return c_qf;
-}
+    // Every distance is final now, not only the one asked for.
+    for (auto& item : xi)
+    {
+        if (item.first != P_s)
+        {
+            this->cache_dist(dist_cache_key(P_s, item.first), item.second);
+        }
+    }
 
-mpz_class Server::query_dist(std::string &F_1_s, std::string &P_s, std::string &P_t, Constrain &constrained_key, size_t ctr)
-{
-    CACHE_ITEM cache_tmp = {P_s, P_t};
-    if (this->cache.find(cache_tmp) != this->cache.end())
+    auto it = xi.find(P_t);
+    if (it != xi.end())
     {
-        g_s_use_cache++;
-        return this->cache[cache_tmp];
+        return it->second;
     }
 
+    // P_t can not be reached.
     mpz_class c_qd;
     JL_encryption(this->pk, 0, c_qd);
+    this->cache_dist(dist_cache_key(P_s, P_t), c_qd);
+    return c_qd;
+}
 
-    FibHeapCompare cmp(*this); // Initializing custom compare function.
-    FIBO_HEAP fh(cmp); // Initializing a fibonacci heap.
-
-    unordered_map<string, FIBO_HEAP::handle_type> heap_handlers; // Use a hash table to access the vertex added into heap.
-    unordered_set<string> chosen_vertices;
+DIST_MAP Server::query_dist_all(std::string &F_1_s, std::string &P_s, Constrain &constrained_key, size_t ctr, size_t max_vertices, size_t max_hops)
+{
+    DIST_MAP rtn;
+    vector<string> settled;
+    size_t exact;
+    rtn.complete = shortest_paths(F_1_s, P_s, nullptr, constrained_key, ctr, max_vertices, max_hops, settled, nullptr, &exact);
+
+    // The vertices settled after the hop budget stopped an expansion are
+    // left to query_dist.
+    rtn.dist.reserve(exact);
+    for (size_t i = 0; i < exact; i++)
+    {
+        rtn.dist.emplace(settled[i], xi[settled[i]]);
+    }
+    return rtn;
+}
 
-    this->xi.clear();
-    this->D_key.clear();
-    this->path.clear();
+namespace
+{
+    /**
+     * One Dijkstra of query_dist_batch, shared by all the requests from P_s.
+     * It is done once no request waits on it.
+    */
+    class DistSearch
+    {
+    public:
+        std::string P_s;
+        unordered_map<string, mpz_class> xi;
+        unordered_map<string, FIBO_HEAP::handle_type> handles;
+        unordered_set<string> chosen;
+        // Indexes of the requests waiting for each P_t.
+        unordered_map<string, vector<size_t>> targets;
+        FIBO_HEAP heap;
+
+        DistSearch(Server& server, const string& P_s)
+            : P_s(P_s), xi(), handles(), chosen(), targets(), heap(FibHeapCompare(server)) {}
+    };
+
+    // xi[P_v] of a search may drop to dist, it takes a secure compare.
+    typedef struct _PENDING_RELAX
+    {
+        size_t search;
+        std::string P_v;
+        mpz_class dist;
+    } PENDING_RELAX;
+}
 
-    // The reason of these steppes is for preventing source vertex from being chosen again.
-    xi[P_s] = this->zero;
-    path[P_s] = PATH_ITEM{P_s, this->zero};
-    heap_handlers[P_s] = fh.push(HEAP_ITEM{P_s, this->zero});
-    fh.pop();
-    chosen_vertices.emplace(P_s); //Important!
+vector<mpz_class> Server::query_dist_batch(vector<Request>& reqs)
+{
+    vector<mpz_class> results(reqs.size());
+    vector<unique_ptr<DistSearch>> searches;
+    unordered_map<string, size_t> search_of;
+    vector<PENDING_RELAX> pending;
 
+    // Out edges unlocked by any of the searches.
     GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
-    Subkeys sub_keys;
-    ggm_derive(&ggm, &constrained_key, &sub_keys);
-    auto neighbors = unlock_adjacency_vertexes(F_1_s, sub_keys, ctr);
+    unordered_map<string, NEIGHBORS> unlocked;
 
-    for (auto each : neighbors)
-    {
-        string& P_v_i = std::get<0>(each);
-        string& F_1_vi = std::get<1>(each);
-        mpz_class& e_i = std::get<2>(each);
+    auto relax = [&](size_t idx, const string& P_v, const mpz_class& dist) {
+        DistSearch& search = *searches[idx];
+        if (search.chosen.find(P_v) != search.chosen.end())
+        {
+            return;
+        }
+        if (search.xi.find(P_v) == search.xi.end())
+        {
+            search.xi[P_v] = dist;
+            search.handles[P_v] = search.heap.push(HEAP_ITEM{P_v, dist});
+            return;
+        }
+        pending.push_back(PENDING_RELAX{idx, P_v, dist});
+    };
 
-        this->path[P_v_i] = PATH_ITEM{P_s, e_i};
-        this->xi[P_v_i] = e_i;
-        FIBO_HEAP::handle_type handler =  fh.push(HEAP_ITEM{P_v_i, xi[P_v_i]});
-        heap_handlers[P_v_i] = handler;
-        this->D_key[P_v_i] = F_1_vi;
-    }
+    auto relax_neighbors = [&](size_t idx, const mpz_class& dist_u, const NEIGHBORS& neighbors) {
+        for (size_t i = 0; i < neighbors.size(); i++)
+        {
+            string P_v_i = neighbors.P(i);
+            this->D_key[P_v_i] = neighbors.F_1(i);
+            relax(idx, P_v_i, JL_homo_add(this->pk, dist_u, neighbors.weight[i]));
+        }
+    };
 
-    ggm_free_keys(&sub_keys);
+    // The compares of every search go out together. A vertex relaxed twice
+    // by the same search waits for the next pass so it sees the first result.
+    auto settle_pending = [&]() {
+        while (!pending.empty())
+        {
+            vector<PENDING_RELAX> pass, later;
+            vector<mpz_class> left, right;
+            vector<unordered_set<string>> in_pass(searches.size());
+            for (auto& item : pending)
+            {
+                DistSearch& search = *searches[item.search];
+                if (search.targets.empty() || search.chosen.find(item.P_v) != search.chosen.end())
+                {
+                    continue;
+                }
+                if (!in_pass[item.search].insert(item.P_v).second)
+                {
+                    later.push_back(std::move(item));
+                    continue;
+                }
+                left.push_back(item.dist);
+                right.push_back(search.xi[item.P_v]);
+                pass.push_back(std::move(item));
+            }
 
-    while(!fh.empty())
-    {
-        HEAP_ITEM hi = fh.top();
-        fh.pop();
-        chosen_vertices.emplace(hi.vertex);
+            vector<bool> lower = compare_batch(left, right, COMPARE_LOWER);
+            for (size_t i = 0; i < pass.size(); i++)
+            {
+                if (lower[i])
+                {
+                    DistSearch& search = *searches[pass[i].search];
+                    search.xi[pass[i].P_v] = pass[i].dist;
+                    search.heap.update(search.handles[pass[i].P_v], HEAP_ITEM{pass[i].P_v, pass[i].dist});
+                }
+            }
+            pending.swap(later);
+        }
+    };
 
-        string &P_u = hi.vertex;
-        if (P_u == P_t)
+    for (size_t r = 0; r < reqs.size(); r++)
+    {
+        Request& req = reqs[r];
+        if (!req.validity)
         {
-            this->cache.emplace(cache_tmp, xi[P_u]);
-            string tmp = let_mpz_raw_to_str(xi[P_u].get_mpz_t());
-            g_s_cache_size += 2 * KEY_SIZE + tmp.size();
-            return xi[P_u];
+            JL_encryption(this->pk, 0, results[r]);
+            continue;
         }
 
-        Subkeys sub_keys;
-        int ctr_inwhile = contact_and_get_ggm_sub_key(ggm, sub_keys, P_u);
-
-        if (ctr_inwhile < 1) {continue;}
+        mpz_class* cached = this->cache.get(dist_cache_key(req.P_s, req.P_t));
+        if (cached != nullptr)
+        {
+            g_s_use_cache++;
+            results[r] = *cached;
+            continue;
+        }
 
-        auto neighbors = unlock_adjacency_vertexes(this->D_key[P_u], sub_keys, ctr_inwhile);
+        auto it = search_of.find(req.P_s);
+        if (it == search_of.end())
+        {
+            size_t idx = searches.size();
+            it = search_of.emplace(req.P_s, idx).first;
+            searches.emplace_back(new DistSearch(*this, req.P_s));
+            searches[idx]->xi[req.P_s] = this->zero;
+            searches[idx]->chosen.emplace(req.P_s);
+
+            NEIGHBORS& slot = unlocked[req.P_s];
+            const NEIGHBORS& neighbors = unlock_source(req.F_1_s, req.P_s, req.constrained_key, req.ctr, slot);
+            if (&neighbors != &slot) { slot = neighbors; }
+            relax_neighbors(idx, this->zero, slot);
+        }
+        searches[it->second]->targets[req.P_t].push_back(r);
+    }
 
-        for (auto each : neighbors)
+    size_t active = searches.size();
+    while (true)
+    {
+        settle_pending();
+        if (active == 0)
         {
-            string& P_v_i = std::get<0>(each);
-            string& F_1_vi = std::get<1>(each);
-            mpz_class& e_i = std::get<2>(each);
+            break;
+        }
 
-            // If cannot find P_v_i in xi, the latter condition may cause error.
-            // Also the first condition checks whether P_v_i is accessed.
-            // if (xi.find(P_v_i) == xi.end() || xi[P_u] + e_i < xi[P_v_i]) 
-            mpz_class tmp(JL_homo_add(this->pk, xi[P_u], e_i));
-            if (xi.find(P_v_i) == xi.end() || compare(tmp, xi[P_v_i], COMPARE_LOWER)) 
+        // Every search still waited on settles one vertex.
+        for (size_t idx = 0; idx < searches.size(); idx++)
+        {
+            DistSearch& search = *searches[idx];
+            if (search.targets.empty())
             {
-                xi[P_v_i] = tmp;
-                path[P_v_i] = PATH_ITEM{P_u, e_i};
+                continue;
             }
 
-            if (heap_handlers.find(P_v_i) == heap_handlers.end())
+            if (search.heap.empty())
             {
-                FIBO_HEAP::handle_type handler = fh.push(HEAP_ITEM{P_v_i, xi[P_v_i]});
-                heap_handlers[P_v_i] = handler;
+                // The rest of the targets can not be reached.
+                for (auto& target : search.targets)
+                {
+                    mpz_class c_qd;
+                    JL_encryption(this->pk, 0, c_qd);
+                    this->cache_dist(dist_cache_key(search.P_s, target.first), c_qd);
+                    for (size_t r : target.second) { results[r] = c_qd; }
+                }
+                search.targets.clear();
+                active--;
+                continue;
             }
-            else
+
+            string P_u = search.heap.top().vertex;
+            search.heap.pop();
+            search.chosen.emplace(P_u);
+
+            mpz_class dist_u = search.xi[P_u];
+            this->cache_dist(dist_cache_key(search.P_s, P_u), dist_u);
+
+            auto target = search.targets.find(P_u);
+            if (target != search.targets.end())
             {
-                // Check if the P_v_i has been chosen, namely the distance of 
-                // P_v_i is shortest.
-                if (chosen_vertices.find(P_v_i) == chosen_vertices.end()) 
+                for (size_t r : target->second) { results[r] = dist_u; }
+                search.targets.erase(target);
+                if (search.targets.empty())
                 {
-                    fh.update(heap_handlers[P_v_i], HEAP_ITEM{P_v_i, xi[P_v_i]});
+                    active--;
+                    continue;
                 }
             }
 
-            D_key[P_v_i] = F_1_vi;
+            auto hit = unlocked.find(P_u);
+            if (hit == unlocked.end())
+            {
+                NEIGHBORS& slot = unlocked[P_u];
+                const NEIGHBORS& neighbors = unlock_vertex(ggm, P_u, slot);
+                if (&neighbors != &slot) { slot = neighbors; }
+                hit = unlocked.find(P_u);
+            }
+            relax_neighbors(idx, dist_u, hit->second);
         }
-
-        ggm_free_keys(&sub_keys);
     }
-    this->cache.emplace(cache_tmp, c_qd);
-    string tmp = let_mpz_raw_to_str(c_qd.get_mpz_t());
-    g_s_cache_size += 2 * KEY_SIZE + tmp.size();
-    return c_qd;
+    return results;
 }
 
 void print_fix_point(mpz_class & in)
@@ -435,62 +1617,61 @@ void print_fix_point(mpz_class & in)
     mpz_class dec, real;
     JL_decryption(g_sk, g_pk, in, dec);
     cout << "Dec: " << dec.get_str() << " Real: " << float(dec.get_ui()) / float(1 << SCALE_SHIFT_P) << endl;
+#else
+    (void)in;
 #endif
 }
 
-void Server::normalize_graph_outedge_weight(tuple<Graph<mpz_class>, Graph<mpz_class>>& double_graph)
+void Server::normalize_graph_outedge_weight(const CSRGraph<mpz_class>& graph, CipherColumn& weights)
 {
-    auto& graph = std::get<0>(double_graph);
-    auto& reverse_graph = std::get<1>(double_graph);
-    for (auto vit = graph.vertices.begin(); vit != graph.vertices.end(); vit ++)
+    for (uint32_t u = 0; u < graph.num_vertices(); u ++)
     {
-        auto& vertex_name = vit->first;
-        auto& vertex_info = vit->second;
-        mpz_class weight_sum;
-        JL_encryption(pk, 0, weight_sum);
-
-        for (auto eit = graph.adjacency_list[vertex_info].begin(); eit != graph.adjacency_list[vertex_info].end(); eit ++)
+        // A sink has nothing to normalize, skip the inverse of zero.
+        if (graph.out_degree(u) == 0)
         {
-            weight_sum = JL_homo_add(pk, weight_sum, eit->weight);
+            continue;
         }
 
+        mpz_class weight_sum;
+        JL_encryption(pk, 0, weight_sum);
+        weights.homo_sum(pk.jl_pk, graph.offsets[u], graph.offsets[u + 1], weight_sum);
+
         mpz_class sum_ivs = inverse(weight_sum);
-        for (auto eit = graph.adjacency_list[vertex_info].begin(); eit != graph.adjacency_list[vertex_info].end(); eit ++)
+        for (size_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e ++)
         {
-            // Divide edge weight by weight sum
-            mpz_class new_weight = multiply(eit->weight, sum_ivs, SCALE_SHIFT_P);
-            // Update each edge
-            graph.modify_edge(eit->src.name, eit->dest.name, new_weight);
-            reverse_graph.modify_edge(eit->dest.name, eit->src.name, new_weight);
+            // Divide edge weight by weight sum, the reverse CSR shares it.
+            mpz_class weight = weights.get(e);
+            weights.set(e, multiply(weight, sum_ivs, SCALE_SHIFT_P));
         }
     }
 }
 
-void Server::unlock_graph(tuple<Graph<mpz_class>, Graph<mpz_class>>& double_graph, string& F_1_s, string& P_s, Constrain& constrained_key, size_t ctr)
+void Server::unlock_graph(CSRGraph<mpz_class>& graph, string& F_1_s, string& P_s, Constrain& constrained_key, size_t ctr)
 {
     queue<string> q;
-    Graph<mpz_class>& graph = std::get<0>(double_graph); // graph for out edges
-    Graph<mpz_class>& reverse_graph = std::get<1>(double_graph); // graph for in edges
+    vector<uint32_t> src, dest;
+    vector<mpz_class> weight;
     GGM ggm = {KEY_SIZE, MAX_GGM_DEPTH};
 
-    Subkeys sub_keys;
-    ggm_derive(&ggm, &constrained_key, &sub_keys);
-    auto neighbors = unlock_adjacency_vertexes(F_1_s, sub_keys, ctr);
-    ggm_free_keys(&sub_keys);
+    graph.clear();
+    uint32_t s = graph.intern(P_s);
 
-    for (auto each : neighbors)
+    NEIGHBORS scratch;
+    const NEIGHBORS& neighbors = unlock_source(F_1_s, P_s, constrained_key, ctr, scratch);
+
+    for (size_t i = 0; i < neighbors.size(); i++)
     {
-        string& P_v = std::get<0>(each);
-        string& F_1_v = std::get<1>(each);
-        mpz_class& ei = std::get<2>(each);
+        string P_v = neighbors.P(i);
+        mpz_class ei = neighbors.weight[i];
 
-        if (graph.vertices.find(P_v) == graph.vertices.end())
+        if (graph.id_of(P_v) == CSR_NO_VERTEX)
         {
             q.push(P_v);
-            this->D_key[P_v] = F_1_v;
+            this->D_key[P_v] = neighbors.F_1(i);
         }
-        graph.add_edge(P_s, P_v, ei);
-        reverse_graph.add_edge(P_v, P_s, ei);
+        src.push_back(s);
+        dest.push_back(graph.intern(P_v));
+        weight.push_back(ei);
     }
 
     while (!q.empty())
@@ -498,34 +1679,27 @@ void Server::unlock_graph(tuple<Graph<mpz_class>, Graph<mpz_class>>& double_grap
         string P_u = q.front();
         q.pop();
         
-        Subkeys sub_keys;
-        int ctr = contact_and_get_ggm_sub_key(ggm, sub_keys, P_u);
-        if (ctr < 1) {continue;}
-        // cout << ctr << endl;
-        // cout << sub_keys.num << endl;
-        // for (int si = 0; si < sub_keys.num; si ++)
-        // {
-        //     for (int idx = 0; idx < KEY_SIZE; idx ++)
-        //         printf("%2hhx ", sub_keys.keys[si][idx]);
-        //     printf("\n");
-        // }
-        auto neighbors = unlock_adjacency_vertexes(this->D_key[P_u], sub_keys, ctr);
-        for (auto each : neighbors)
-        {
-            string& P_v = std::get<0>(each);
-            string& F_1_v = std::get<1>(each);
-            mpz_class& ei = std::get<2>(each);
-
-            if (graph.vertices.find(P_v) == graph.vertices.end())
+        const NEIGHBORS& neighbors = unlock_vertex(ggm, P_u, scratch);
+        if (neighbors.size() == 0) {continue;}
+        uint32_t u = graph.id_of(P_u);
+        for (size_t i = 0; i < neighbors.size(); i++)
+        {
+            string P_v = neighbors.P(i);
+            mpz_class ei = neighbors.weight[i];
+
+            if (graph.id_of(P_v) == CSR_NO_VERTEX)
             {
                 q.push(P_v);
-                this->D_key[P_v] = F_1_v;
+                this->D_key[P_v] = neighbors.F_1(i);
             }
-            graph.add_edge(P_u, P_v, ei);
-            reverse_graph.add_edge(P_v, P_u, ei);
+            src.push_back(u);
+            dest.push_back(graph.intern(P_v));
+            weight.push_back(ei);
         }
-        ggm_free_keys(&sub_keys);
     }
+
+    graph.assign(src, dest, weight);
+    graph.build_reverse(); // in edges for page rank
 }
 
 unordered_map<Vertex, mpz_class> Server::page_rank(std::string &F_1_s, std::string &P_s, Constrain &constrained_key, size_t ctr, int epochs)
@@ -537,49 +1711,59 @@ unordered_map<Vertex, mpz_class> Server::page_rank(std::string &F_1_s, std::stri
     JL_encryption(this->pk.jl_pk, raw_d, enc_d);
     JL_encryption(this->pk.jl_pk, one_sub_d, enc_1sd);
 
-    auto double_graph = std::make_tuple(Graph<mpz_class>(), Graph<mpz_class>());
+    CSRGraph<mpz_class> graph;
 auto ulk_start_time = chrono::high_resolution_clock::now();
-    unlock_graph(double_graph, F_1_s, P_s, constrained_key, ctr);
+    unlock_graph(graph, F_1_s, P_s, constrained_key, ctr);
 auto ulk_end_time = chrono::high_resolution_clock::now();
 cout << "Unlock time: " << chrono::duration<double>(ulk_end_time - ulk_start_time).count() << endl;
+
+    CipherColumn weights;
+    weights.assign(graph.weights);
+    vector<mpz_class>().swap(graph.weights);
+
 auto nml_start_time = chrono::high_resolution_clock::now();
-    normalize_graph_outedge_weight(double_graph);
+    normalize_graph_outedge_weight(graph, weights);
 auto nml_end_time = chrono::high_resolution_clock::now();
 cout << "Nomalize time: " << chrono::duration<double>(nml_end_time - nml_start_time).count() << endl;
 
-    Graph<mpz_class>& graph = std::get<0>(double_graph); // graph for out edges
-    Graph<mpz_class>& reverse_graph = std::get<1>(double_graph); // graph for in edges
-
-    unordered_map<Vertex, mpz_class> PR_list;
-    for (auto it = graph.vertices.begin(); it != graph.vertices.end(); it ++)
+    size_t n = graph.num_vertices();
+    CipherColumn PR_list(n);
+    for (uint32_t v = 0; v < n; v ++)
     {
         mpz_class one;
         JL_encryption(this->pk, 1 << SCALE_SHIFT_P, one);
-        PR_list[it->second] = one;
+        PR_list.set(v, one);
     }
 
     for (int e = 0; e < epochs; e ++)
     {
     auto start_time = chrono::high_resolution_clock::now();
-        for (auto it = PR_list.begin(); it != PR_list.end(); it ++)
+        for (uint32_t v = 0; v < n; v ++)
         {
-            auto& pr_value = it->second;
-            auto& vertex = it->first;
             mpz_class sum;
             JL_encryption(this->pk, 0, sum);
-            for (auto adj_it = reverse_graph.adjacency_list[vertex].begin(); adj_it != reverse_graph.adjacency_list[vertex].end(); adj_it ++)
+            for (size_t i = graph.rev_offsets[v]; i < graph.rev_offsets[v + 1]; i ++)
             {
-                mpz_class mul = multiply(PR_list[adj_it->dest], adj_it->weight, SCALE_SHIFT_P);
+                mpz_class pr_src = PR_list.get(graph.rev_sources[i]);
+                mpz_class weight = weights.get(graph.rev_edges[i]);
+                mpz_class mul = multiply(pr_src, weight, SCALE_SHIFT_P);
                 sum = JL_homo_add(this->pk, sum, mul);
             }
-            pr_value = sum;
-            pr_value = multiply(pr_value, enc_d, SCALE_SHIFT_P);
-            pr_value = JL_homo_add(this->pk, pr_value, enc_1sd);
+            mpz_class pr_value = multiply(sum, enc_d, SCALE_SHIFT_P);
+            PR_list.set(v, pr_value);
+            PR_list.homo_add(this->pk.jl_pk, v, enc_1sd);
         }
     auto end_time = chrono::high_resolution_clock::now();
     cout << "Iter: " << e << " time: " << chrono::duration<double>(end_time - start_time).count() << endl;
     }
-    return PR_list;
+
+    unordered_map<Vertex, mpz_class> rtn;
+    rtn.reserve(n);
+    for (uint32_t v = 0; v < n; v ++)
+    {
+        rtn.emplace(Vertex{graph.names[v], graph.in_degree(v), graph.out_degree(v)}, PR_list.get(v));
+    }
+    return rtn;
 }
 
 void Server::network_init()
@@ -597,16 +1781,20 @@ void Server::oblivc_init()
 }
 
 Server::Server(boost::asio::ip::tcp::socket& sock, boost::asio::ip::tcp::endpoint& proxy_info)
-    : D_e(), pk(), level(), D_key(), xi(), path(), sever_graph(),
-        zero(), cache(), pd({0}), sock(std::move(sock)), proxy_info(proxy_info)
+    : pk(), pd(), sock(std::move(sock)), proxy_info(proxy_info), D_e(), D_l(), D_a(), D_key(), cap_r(), level(),
+        xi(), sever_graph(), caps(), arc_open(), zero(), cmp_width(compare_width(SEC_GDB_INF)),
+        value_bound(SEC_GDB_INF), pool(new ThreadPool(1)), masks(), adj_cache(), vertex_ctr(),
+        cache((size_t)DIST_CACHE_DEFAULT_MB << 20)
 {
     JL_encryption(this->pk, 0, this->zero);
     network_init();
     oblivc_init();
 }
 Server::Server(const unordered_map<string, string> &de, const PK &pk, boost::asio::ip::tcp::socket& sock, boost::asio::ip::tcp::endpoint& proxy_info)
-    : D_e(de), pk(pk), level(), D_key(), xi(), path(), sever_graph(),
-        zero(), cache(), pd({0}), sock(std::move(sock)), proxy_info(proxy_info)
+    : pk(pk), pd(), sock(std::move(sock)), proxy_info(proxy_info), D_e(de), D_l(), D_a(), D_key(), cap_r(), level(),
+        xi(), sever_graph(), caps(), arc_open(), zero(), cmp_width(compare_width(SEC_GDB_INF)),
+        value_bound(SEC_GDB_INF), pool(new ThreadPool(1)), masks(), adj_cache(), vertex_ctr(),
+        cache((size_t)DIST_CACHE_DEFAULT_MB << 20)
 {
     JL_encryption(this->pk, 0, this->zero);
     network_init();
@@ -616,5 +1804,22 @@ Server::Server(const unordered_map<string, string> &de, const PK &pk, boost::asi
 Server::~Server()
 {
     // cleanupProtocol(&pd);
+    this->set_mask_pool(0);
     sock.close();
+}
+
+void Server::set_mask_pool(size_t depth, int threads)
+{
+    use_mask_pool(nullptr);
+    this->masks.reset();
+    if (depth == 0)
+    {
+        return;
+    }
+
+    // Sizes known up front: encryptions of zero, the compare, min and sign
+    // masks at the current width and the multiply masks.
+    vector<int> bits = {0, width_bits(this->cmp_width) - 2, (int)sizeof(OBLIVC_DATA_TYPE) * 4 - 1};
+    this->masks.reset(new MaskPool(mask_generator(this->pk.jl_pk), depth, bits, threads));
+    use_mask_pool(this->masks.get());
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef SEC_GDB_H_TEST_GRAPH_FIXTURE
+#define SEC_GDB_H_TEST_GRAPH_FIXTURE
+
+#include <vector>
+#include <queue>
+#include <random>
+#include <string>
+#include <functional>
+
+#include "graph.hpp"
+
+// Distance of an unreachable vertex in reference_dijkstra, the same as
+// HUB_NO_PATH, LANDMARK_NO_PATH and CH_NO_PATH.
+const size_t REFERENCE_NO_PATH = (size_t)-1;
+
+/**
+ * Plain Dijkstra over the CSR graph, the reference the shortest path
+ * indexes are checked against.
+*/
+inline std::vector<size_t> reference_dijkstra(const CSRGraph<size_t> &graph, uint32_t s)
+{
+    typedef std::pair<size_t, uint32_t> ITEM;
+    std::vector<size_t> dist(graph.num_vertices(), REFERENCE_NO_PATH);
+    std::priority_queue<ITEM, std::vector<ITEM>, std::greater<ITEM>> q;
+    dist[s] = 0;
+    q.push(ITEM(0, s));
+    while (!q.empty())
+    {
+        ITEM top = q.top();
+        q.pop();
+        if (top.first > dist[top.second]) { continue; }
+        for (size_t e = graph.offsets[top.second]; e < graph.offsets[top.second + 1]; e++)
+        {
+            size_t d = top.first + graph.weights[e];
+            if (d < dist[graph.targets[e]])
+            {
+                dist[graph.targets[e]] = d;
+                q.push(ITEM(d, graph.targets[e]));
+            }
+        }
+    }
+    return dist;
+}
+
+/**
+ * edges random edges between vertices named 0 to vertices - 1, weighted
+ * 1 to 50. The same seed gives the same graph.
+*/
+inline void random_graph(Graph<size_t> &graph, unsigned seed, int vertices, int edges)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> vertex(0, vertices - 1), weight(1, 50);
+    for (int i = 0; i < edges; i++)
+    {
+        std::string src = std::to_string(vertex(gen)), dest = std::to_string(vertex(gen));
+        size_t w = weight(gen);
+        graph.add_edge(src, dest, w);
+    }
+}
+
+/**
+ * A road network like grid of rows by cols, a quarter of the streets one
+ * way only, weighted 1 to 50.
+*/
+inline void random_grid(Graph<size_t> &graph, unsigned seed, int rows, int cols)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> weight(1, 50), coin(0, 3);
+    auto street = [&](int a, int b) {
+        std::string src = std::to_string(a), dest = std::to_string(b);
+        size_t w = weight(gen);
+        graph.add_edge(src, dest, w);
+        if (coin(gen) != 0)
+        {
+            w = weight(gen);
+            graph.add_edge(dest, src, w);
+        }
+    };
+    for (int r = 0; r < rows; r++)
+    {
+        for (int c = 0; c < cols; c++)
+        {
+            if (c + 1 < cols) { street(r * cols + c, r * cols + c + 1); }
+            if (r + 1 < rows) { street(r * cols + c, (r + 1) * cols + c); }
+        }
+    }
+}
+
+#endif // SEC_GDB_H_TEST_GRAPH_FIXTURE
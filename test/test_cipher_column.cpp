@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <gmpxx.h>
+
+#include "cipher_column.hpp"
+
+using namespace std;
+
+/**
+ * Check the in place operations of CipherColumn against plain mpz
+ * arithmetic mod a random odd N, which is all the JL operations use.
+*/
+int main(int argc, char **argv)
+{
+    gmp_randclass rand(gmp_randinit_default);
+    rand.seed(2333);
+
+    JL_PK jl_pk;
+    // bhjl_gen can give a N of JL_MODULUS + 1 bits, test the largest.
+    jl_pk.N = rand.get_z_bits(JL_MODULUS + 1);
+    mpz_setbit(jl_pk.N.get_mpz_t(), JL_MODULUS);
+    mpz_setbit(jl_pk.N.get_mpz_t(), 0);
+    mpz_class &N = jl_pk.N;
+
+    const size_t n = 64;
+    vector<mpz_class> values(n), others(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        // Units mod N, the inverse has to exist for sub.
+        do { values[i] = rand.get_z_range(N); } while (gcd(values[i], N) != 1);
+        do { others[i] = rand.get_z_range(N); } while (gcd(others[i], N) != 1);
+    }
+
+    CipherColumn col, other;
+    col.assign(values);
+    other.assign(others);
+
+    int rc = 0;
+    auto expect = [&rc](const mpz_class &got, const mpz_class &want, const char *what, size_t i) {
+        if (got != want)
+        {
+            cout << what << " mismatch at " << i << endl;
+            rc = 1;
+        }
+    };
+
+    for (size_t i = 0; i < n; i++)
+    {
+        expect(col[i], values[i], "get", i);
+
+        mpz_class want = values[i] * others[i] % N;
+        col.homo_add(jl_pk, i, other, i);
+        expect(col[i], want, "add", i);
+
+        mpz_class inv;
+        mpz_invert(inv.get_mpz_t(), others[i].get_mpz_t(), N.get_mpz_t());
+        want = want * inv % N;
+        col.homo_sub(jl_pk, i, others[i]);
+        expect(col[i], want, "sub", i);
+
+        mpz_class scalar(i + 3);
+        mpz_powm(want.get_mpz_t(), want.get_mpz_t(), scalar.get_mpz_t(), N.get_mpz_t());
+        col.homo_mul(jl_pk, i, scalar);
+        expect(col[i], want, "mul", i);
+
+        values[i] = want;
+    }
+
+    mpz_class sum(1), want(1);
+    col.homo_sum(jl_pk, 0, n, sum);
+    for (size_t i = 0; i < n; i++)
+    {
+        want = want * values[i] % N;
+    }
+    expect(sum, want, "sum", 0);
+
+    col[0] = other[1];
+    expect(col[0], others[1], "copy", 0);
+
+    // The largest ciphertext takes every bit of the widest N.
+    mpz_class largest = N - 1;
+    col[1] = largest;
+    expect(col[1], largest, "largest", 1);
+    col.homo_mul(jl_pk, 1, mpz_class(1));
+    expect(col[1], largest, "largest mul", 1);
+
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
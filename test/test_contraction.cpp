@@ -0,0 +1,63 @@
+#include <iostream>
+#include <vector>
+
+#include "contraction.hpp"
+#include "graph_fixture.hpp"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    // A road network like grid, some streets one way only.
+    Graph<size_t> graph;
+    random_grid(graph, 11, 16, 16);
+
+    CSRGraph<size_t> csr;
+    csr.assign(graph);
+
+    CH_GRAPH ch;
+    int rc = 0;
+    if (build_contraction_hierarchy(csr, ch))
+    {
+        cout << "hierarchy built without the reverse CSR" << endl;
+        rc = 1;
+    }
+
+    csr.build_reverse();
+    if (!build_contraction_hierarchy(csr, ch))
+    {
+        cout << "build failed" << endl;
+        return 1;
+    }
+
+    size_t total = 0, mismatches = 0, order = 0;
+    for (uint32_t v = 0; v < csr.num_vertices(); v++)
+    {
+        total += ch.up[v].size() + ch.down[v].size();
+        for (auto &e : ch.up[v]) { if (ch.rank[e.v] <= ch.rank[v]) { order++; } }
+        for (auto &e : ch.down[v]) { if (ch.rank[e.v] <= ch.rank[v]) { order++; } }
+    }
+    for (uint32_t s = 0; s < csr.num_vertices(); s += 3)
+    {
+        vector<size_t> want = reference_dijkstra(csr, s);
+        for (uint32_t t = 0; t < csr.num_vertices(); t++)
+        {
+            if (ch_distance(ch, s, t) != want[t]) { mismatches++; }
+        }
+    }
+    if (order > 0)
+    {
+        cout << order << " edges do not go up the hierarchy" << endl;
+        rc = 1;
+    }
+    if (mismatches > 0)
+    {
+        cout << mismatches << " distances differ" << endl;
+        rc = 1;
+    }
+
+    cout << csr.num_vertices() << " vertices, " << ch.num_shortcuts << " shortcuts, "
+         << double(total) / csr.num_vertices() << " edges per vertex" << endl;
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
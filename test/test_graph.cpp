@@ -0,0 +1,210 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <cstdio>
+
+#include "graph.hpp"
+
+using namespace std;
+
+/**
+ * Build the graph the way the line based reader did, one add_edge per line.
+*/
+void build_reference(Graph<size_t> &graph, const string &text)
+{
+    istringstream in(text);
+    string line;
+    while (getline(in, line))
+    {
+        istringstream fields(line);
+        string src, dest;
+        long weight;
+        if (line.empty() || line[0] == '#' || !(fields >> src >> dest >> weight))
+        {
+            continue;
+        }
+        size_t w = (size_t)weight;
+        graph.add_edge(src, dest, w);
+    }
+}
+
+bool same_graph(Graph<size_t> &x, Graph<size_t> &y)
+{
+    if (x.num_vertices != y.num_vertices || x.num_edges != y.num_edges)
+    {
+        return false;
+    }
+
+    for (auto &v : x.vertices)
+    {
+        auto it = y.vertices.find(v.first);
+        if (it == y.vertices.end() ||
+            it->second.in_degree != v.second.in_degree || it->second.out_degree != v.second.out_degree)
+        {
+            return false;
+        }
+
+        auto &adj_x = x.adjacency_list.at(v.second);
+        auto &adj_y = y.adjacency_list.at(it->second);
+        if (adj_x.size() != adj_y.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < adj_x.size(); i++)
+        {
+            if (adj_x[i].dest.name != adj_y[i].dest.name || adj_x[i].weight != adj_y[i].weight)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * The CSR form has the same edges as the graph, in both directions.
+*/
+bool check_csr(Graph<size_t> &graph)
+{
+    CSRGraph<size_t> csr;
+    csr.assign(graph);
+    csr.build_reverse();
+
+    if (csr.num_vertices() != graph.num_vertices || csr.num_edges() != graph.num_edges)
+    {
+        return false;
+    }
+
+    for (auto &v : graph.vertices)
+    {
+        uint32_t u = csr.id_of(v.first);
+        if (u == CSR_NO_VERTEX || csr.out_degree(u) != v.second.out_degree || csr.in_degree(u) != v.second.in_degree)
+        {
+            return false;
+        }
+        for (auto &e : graph.adjacency_list.at(v.second))
+        {
+            size_t at = csr.find_edge(u, csr.id_of(e.dest.name));
+            if (at == csr.num_edges() || csr.weights[at] != e.weight)
+            {
+                return false;
+            }
+        }
+        for (size_t i = csr.rev_offsets[u]; i < csr.rev_offsets[u + 1]; i++)
+        {
+            if (csr.targets[csr.rev_edges[i]] != u || csr.find_edge(csr.rev_sources[i], u) != csr.rev_edges[i])
+            {
+                return false;
+            }
+        }
+    }
+
+    // Every edge of a residual graph is paired with the one going back.
+    size_t zero = 0;
+    auto added = csr.build_residual(zero);
+    size_t num_added = 0;
+    for (size_t u = 0; u < csr.num_vertices(); u++)
+    {
+        for (size_t e = csr.offsets[u]; e < csr.offsets[u + 1]; e++)
+        {
+            size_t back = csr.pair[e];
+            if (back == csr.num_edges() || csr.targets[back] != u || csr.pair[back] != e)
+            {
+                return false;
+            }
+            if (added[e])
+            {
+                num_added++;
+                if (csr.weights[e] != 0) { return false; }
+            }
+        }
+    }
+    return csr.num_edges() == graph.num_edges + num_added;
+}
+
+int main(int argc, char **argv)
+{
+    // Comments, tabs, CRLF, short lines and duplicated edges.
+    ostringstream text;
+    text << "# Directed graph\n"
+         << "a b 3\n"
+         << "a\tc\t4\r\n"
+         << "\n"
+         << "b c\n"
+         << "a b 7\n"
+         << "c a 1";
+
+    mt19937 gen(7);
+    uniform_int_distribution<int> vertex(0, 200), weight(1, 100);
+    for (int i = 0; i < 5000; i++)
+    {
+        text << "\n" << vertex(gen) << " " << vertex(gen) << " " << weight(gen);
+    }
+    text << "\n";
+
+    string path = "test_graph.txt";
+    ofstream(path) << text.str();
+
+    Graph<size_t> reference;
+    build_reference(reference, text.str());
+
+    int rc = 0;
+    for (int threads : {1, 3})
+    {
+        EDGE_LIST edges;
+        Graph<size_t> graph;
+        if (!parse_edge_list(path, edges, threads))
+        {
+            cout << "parse failed with " << threads << " threads" << endl;
+            rc = 1;
+            continue;
+        }
+        build_graph(graph, edges);
+        if (!same_graph(graph, reference))
+        {
+            cout << "graph mismatch with " << threads << " threads" << endl;
+            rc = 1;
+        }
+    }
+
+    if (!check_csr(reference))
+    {
+        cout << "csr mismatch" << endl;
+        rc = 1;
+    }
+
+    // The cache is used once it exists.
+    EDGE_LIST edges;
+    parse_edge_list(path, edges);
+    if (!save_edge_list_cache(edge_list_cache_path(path), path, edges))
+    {
+        cout << "save cache failed" << endl;
+        rc = 1;
+    }
+    Graph<size_t> cached;
+    build_graph(cached, path);
+    if (!same_graph(cached, reference))
+    {
+        cout << "graph mismatch with cache" << endl;
+        rc = 1;
+    }
+
+    // An edit right after the cache was written, likely within the same
+    // second, still makes the file parsed again.
+    ofstream(path, ios::app) << "x y 5\n";
+    Graph<size_t> edited;
+    build_graph(edited, path);
+    if (edited.num_vertices != reference.num_vertices + 2)
+    {
+        cout << "stale cache used after an edit" << endl;
+        rc = 1;
+    }
+
+    remove(edge_list_cache_path(path).c_str());
+    remove(path.c_str());
+
+    cout << reference.num_vertices << " vertices, " << reference.num_edges << " edges" << endl;
+    return rc;
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <vector>
+
+#include "hub_labels.hpp"
+#include "graph_fixture.hpp"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    // Sparse enough to leave some pairs unreachable.
+    Graph<size_t> graph;
+    random_graph(graph, 11, 300, 700);
+
+    CSRGraph<size_t> csr;
+    csr.assign(graph);
+
+    HUB_LABELS labels;
+    int rc = 0;
+    if (build_hub_labels(csr, labels))
+    {
+        cout << "labels built without the reverse CSR" << endl;
+        rc = 1;
+    }
+
+    csr.build_reverse();
+    if (!build_hub_labels(csr, labels))
+    {
+        cout << "build failed" << endl;
+        return 1;
+    }
+
+    size_t total = 0, mismatches = 0;
+    for (uint32_t s = 0; s < csr.num_vertices(); s++)
+    {
+        vector<size_t> want = reference_dijkstra(csr, s);
+        for (uint32_t t = 0; t < csr.num_vertices(); t++)
+        {
+            if (hub_distance(labels, s, t) != want[t]) { mismatches++; }
+        }
+        total += labels.out[s].size() + labels.in[s].size();
+    }
+    if (mismatches > 0)
+    {
+        cout << mismatches << " distances differ" << endl;
+        rc = 1;
+    }
+
+    cout << csr.num_vertices() << " vertices, " << double(total) / csr.num_vertices() << " labels per vertex" << endl;
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+
+#include "client.hpp"
+#include "graph_fixture.hpp"
+
+using namespace std;
+
+// Timers of update_graph, defined by main.
+double g_c_update_clt = 0.0;
+double g_c_update_srv = 0.0;
+double g_c_update_prxy = 0.0;
+
+/**
+ * Check the records of D_l as the server stores them. The F_1_v field is
+ * not used by the labels, but it is masked like the others, so it must
+ * not come out as the mask itself.
+*/
+int main(int argc, char **argv)
+{
+    SK sk;
+    PK pk;
+    sample_key(sk, pk);
+    Client client;
+    client.set_keys(pk, sk);
+    random_graph(client.get_graph(), 5, 60, 150);
+    if (!client.enc_hub_labels(0, 2))
+    {
+        cout << "labels failed" << endl;
+        return 1;
+    }
+
+    // The same vertex ids as enc_hub_labels.
+    CSRGraph<size_t> csr;
+    csr.assign(client.get_graph());
+
+    const unordered_map<string, string> &D_l = client.get_Dl();
+    size_t found = 0, bare = 0;
+    unsigned char F_1[KEY_SIZE], token[EDGE_TOKEN_SIZE];
+    for (uint32_t v = 0; v < csr.num_vertices(); v++)
+    {
+        F_batch(client.get_sk().f_1, &csr.names[v], 1, F_1);
+        EDGE_TOKEN_CTX ctx;
+        edge_token_init(ctx, F_1, KEY_SIZE);
+        for (char dir : {HUB_LABEL_OUT, HUB_LABEL_IN})
+        {
+            for (uint32_t i = 0; ; i++)
+            {
+                label_token(ctx, dir, i, token);
+                auto it = D_l.find(string((char*)token, KEY_SIZE));
+                if (it == D_l.end()) { break; }
+                found++;
+                if (memcmp(it->second.data() + KEY_SIZE, token + KEY_SIZE, KEY_SIZE) == 0) { bare++; }
+            }
+        }
+    }
+
+    int rc = 0;
+    if (found != D_l.size())
+    {
+        cout << found << " of " << D_l.size() << " records found" << endl;
+        rc = 1;
+    }
+    if (bare > 0)
+    {
+        cout << bare << " records give their mask away" << endl;
+        rc = 1;
+    }
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "landmarks.hpp"
+#include "graph_fixture.hpp"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    Graph<size_t> graph;
+    random_graph(graph, 7, 400, 900);
+
+    CSRGraph<size_t> csr;
+    csr.assign(graph);
+    csr.build_reverse();
+
+    LANDMARKS landmarks;
+    if (!select_landmarks(csr, 8, landmarks) || landmarks.vertices.size() != 8)
+    {
+        cout << "select failed" << endl;
+        return 1;
+    }
+    size_t cap = landmark_cap(landmarks);
+
+    // The capped potentials the server orders by, they have to be feasible
+    // on every edge: pi(u) <= w + pi(v).
+    auto fwd = [&](size_t j, uint32_t v) { return cap - min(landmarks.from[j][v], cap); };
+    auto bwd = [&](size_t j, uint32_t v) { return min(landmarks.to[j][v], cap); };
+
+    int rc = 0;
+    size_t infeasible = 0, inadmissible = 0;
+    for (size_t j = 0; j < landmarks.vertices.size(); j++)
+    {
+        for (uint32_t u = 0; u < csr.num_vertices(); u++)
+        {
+            for (size_t e = csr.offsets[u]; e < csr.offsets[u + 1]; e++)
+            {
+                uint32_t v = csr.targets[e];
+                if (fwd(j, u) > csr.weights[e] + fwd(j, v)) { infeasible++; }
+                if (bwd(j, u) > csr.weights[e] + bwd(j, v)) { infeasible++; }
+            }
+        }
+    }
+
+    for (uint32_t s = 0; s < csr.num_vertices(); s += 7)
+    {
+        vector<size_t> dist = reference_dijkstra(csr, s);
+        for (uint32_t t = 0; t < csr.num_vertices(); t++)
+        {
+            if (dist[t] == LANDMARK_NO_PATH) { continue; }
+            for (size_t j = 0; j < landmarks.vertices.size(); j++)
+            {
+                if (fwd(j, s) > dist[t] + fwd(j, t) || bwd(j, s) > dist[t] + bwd(j, t)) { inadmissible++; }
+            }
+        }
+    }
+
+    if (infeasible > 0)
+    {
+        cout << infeasible << " infeasible potentials" << endl;
+        rc = 1;
+    }
+    if (inadmissible > 0)
+    {
+        cout << inadmissible << " bounds over the distance" << endl;
+        rc = 1;
+    }
+
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
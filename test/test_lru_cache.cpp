@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lru_cache.hpp"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    int rc = 0;
+    auto expect = [&rc](bool ok, const char *what) {
+        if (!ok)
+        {
+            cout << what << " failed" << endl;
+            rc = 1;
+        }
+    };
+
+    LRUCache<string, int> disabled;
+    expect(disabled.put("a", 1, 1) == nullptr && disabled.get("a") == nullptr, "disabled");
+
+    LRUCache<string, int> cache(10);
+    cache.put("a", 1, 4);
+    cache.put("b", 2, 4);
+    expect(cache.get("a") != nullptr && *cache.get("a") == 1, "get");
+
+    // b is the least recently used one now and has to go first.
+    cache.put("c", 3, 4);
+    expect(cache.peek("b") == nullptr && cache.peek("a") != nullptr && cache.peek("c") != nullptr, "evict lru");
+    expect(cache.bytes() == 8 && cache.size() == 2 && cache.evictions() == 1, "bytes");
+
+    // Replacing a key releases its old bytes.
+    cache.put("a", 4, 6);
+    expect(*cache.peek("a") == 4 && cache.bytes() == 10, "replace");
+
+    expect(cache.put("big", 5, 11) == nullptr && cache.peek("big") == nullptr, "too big");
+    expect(cache.erase("c") && !cache.erase("c") && cache.bytes() == 6, "erase");
+
+    cache.reset_stats();
+    cache.get("a");
+    cache.get("x");
+    expect(cache.hits() == 1 && cache.misses() == 1 && cache.hit_rate() == 0.5, "stats");
+
+    // for_each goes from the oldest, copying keeps the order.
+    cache.put("d", 6, 2);
+    cache.get("a");
+    vector<string> order;
+    cache.for_each([&order](const string &key, const int &, size_t) { order.push_back(key); });
+    expect(order.size() == 2 && order[0] == "d" && order[1] == "a", "order");
+
+    cache.set_capacity(6);
+    expect(cache.peek("d") == nullptr && cache.peek("a") != nullptr, "shrink");
+
+    cache.clear();
+    expect(cache.size() == 0 && cache.bytes() == 0, "clear");
+
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <atomic>
+#include <set>
+#include <gmpxx.h>
+
+#include "mask_pool.hpp"
+
+using namespace std;
+
+/**
+ * Check MaskPool with a generator whose pairs can be told apart: every
+ * pair handed out has to match, none twice, and the queues fill up in the
+ * background, including the ones of sizes seen late.
+*/
+int main(int argc, char **argv)
+{
+    atomic<unsigned long> counter(0);
+    MaskPool::GENERATOR gen = [&counter](int bits, mpz_class &mask, mpz_class &enc) {
+        mask = counter++;
+        enc = mask * 3 + bits;
+    };
+
+    const size_t depth = 32;
+    MaskPool pool(gen, depth, {14, 30}, 2);
+    pool.wait_full();
+
+    int rc = 0;
+    auto expect = [&rc](bool ok, const char *what) {
+        if (!ok)
+        {
+            cout << what << endl;
+            rc = 1;
+        }
+    };
+
+    expect(pool.ready(14) == depth && pool.ready(30) == depth, "queues not filled");
+
+    set<unsigned long> seen;
+    mpz_class mask, enc;
+    for (int round = 0; round < 4; round++)
+    {
+        for (int bits : {14, 30, 62})
+        {
+            for (size_t i = 0; i < depth; i++)
+            {
+                pool.take(bits, mask, enc);
+                expect(enc == mask * 3 + bits, "mask and encryption do not match");
+                expect(seen.insert(mask.get_ui()).second, "mask handed out twice");
+            }
+        }
+        pool.wait_full();
+    }
+
+    // 62 bits was unknown until the first take of it.
+    expect(pool.ready(62) == depth, "late size not filled");
+    expect(pool.misses() >= 1, "first take of a new size should miss");
+    expect(pool.hits() + pool.misses() == 4 * 3 * depth, "takes not counted");
+    expect(pool.hits() >= 2 * 4 * depth, "known sizes should be served from the queues");
+
+    MaskPool idle(gen, depth, {30}, 0);
+    idle.take(30, mask, enc);
+    expect(enc == mask * 3 + 30 && idle.misses() == 1, "pool without workers");
+
+    cout << (rc == 0 ? "OK" : "FAILED") << endl;
+    return rc;
+}
@@ -0,0 +1,177 @@
+#include <vector>
+#include <gmpxx.h>
+
+#include "cipher_column.hpp"
+#include "exceptions.hpp"
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Write value into a slot. Ciphertexts are never negative, plaintexts
+     * without encryption are kept in two's complement.
+    */
+    void store_limbs(mp_limb_t *dst, mpz_srcptr value)
+    {
+        size_t size = mpz_size(value);
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        if (size > CIPHER_LIMBS) { size = CIPHER_LIMBS; }
+#else
+        if (size > CIPHER_LIMBS || mpz_sgn(value) < 0)
+        {
+            throw sec_gdb_global_exception("Ciphertext does not fit in a column slot!");
+        }
+#endif
+        if (size > 0) { mpn_copyi(dst, mpz_limbs_read(value), size); }
+        if (size < CIPHER_LIMBS) { mpn_zero(dst + size, CIPHER_LIMBS - size); }
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        if (mpz_sgn(value) < 0) { mpn_neg(dst, dst, CIPHER_LIMBS); }
+#endif
+    }
+
+    void load_limbs(mpz_ptr out, const mp_limb_t *src)
+    {
+        mpz_t view;
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        if (src[CIPHER_LIMBS - 1] >> (GMP_NUMB_BITS - 1))
+        {
+            mp_limb_t abs[CIPHER_LIMBS];
+            mpn_neg(abs, src, CIPHER_LIMBS);
+            mpz_neg(out, mpz_roinit_n(view, abs, CIPHER_LIMBS));
+            return;
+        }
+#endif
+        mpz_set(out, mpz_roinit_n(view, src, CIPHER_LIMBS));
+    }
+
+    // dst = left * right mod N, dst may be left or right.
+    void mul_mod(mp_limb_t *dst, const mp_limb_t *left, const mp_limb_t *right, const JL_PK &jl_pk)
+    {
+        mp_limb_t prod[2 * CIPHER_LIMBS];
+        mpn_mul_n(prod, left, right, CIPHER_LIMBS);
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        mpn_copyi(dst, prod, CIPHER_LIMBS);
+#else
+        mpz_srcptr N = jl_pk.N.get_mpz_t();
+        mp_size_t n_size = mpz_size(N);
+        mp_limb_t quot[2 * CIPHER_LIMBS + 1];
+        mp_limb_t rem[CIPHER_LIMBS];
+        mpn_tdiv_qr(quot, rem, 0, prod, 2 * CIPHER_LIMBS, mpz_limbs_read(N), n_size);
+        mpn_copyi(dst, rem, n_size);
+        if (n_size < CIPHER_LIMBS) { mpn_zero(dst + n_size, CIPHER_LIMBS - n_size); }
+#endif
+    }
+
+    void add_limbs(mp_limb_t *dst, const mp_limb_t *right, const JL_PK &jl_pk)
+    {
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        mpn_add_n(dst, dst, right, CIPHER_LIMBS);
+#else
+        mul_mod(dst, dst, right, jl_pk);
+#endif
+    }
+
+    void sub_limbs(mp_limb_t *dst, const mp_limb_t *right, const JL_PK &jl_pk)
+    {
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+        mpn_sub_n(dst, dst, right, CIPHER_LIMBS);
+#else
+        // The inverse needs a real mpz, it is the only allocation here.
+        mpz_t view, inv;
+        mpz_init2(inv, JL_MODULUS);
+        mpz_invert(inv, mpz_roinit_n(view, right, CIPHER_LIMBS), jl_pk.N.get_mpz_t());
+
+        mp_limb_t inv_limbs[CIPHER_LIMBS];
+        store_limbs(inv_limbs, inv);
+        mpz_clear(inv);
+
+        mul_mod(dst, dst, inv_limbs, jl_pk);
+#endif
+    }
+} // namespace
+
+CipherColumn::CipherColumn(size_t n) : limbs(n * CIPHER_LIMBS, 0)
+{
+}
+
+void CipherColumn::assign(const vector<mpz_class> &values)
+{
+    this->limbs.assign(values.size() * CIPHER_LIMBS, 0);
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        store_limbs(this->data(i), values[i].get_mpz_t());
+    }
+}
+
+void CipherColumn::get(size_t i, mpz_class &out) const
+{
+    load_limbs(out.get_mpz_t(), this->data(i));
+}
+
+mpz_class CipherColumn::get(size_t i) const
+{
+    mpz_class out;
+    this->get(i, out);
+    return out;
+}
+
+void CipherColumn::set(size_t i, const mpz_class &value)
+{
+    store_limbs(this->data(i), value.get_mpz_t());
+}
+
+void CipherColumn::set(size_t i, const CipherColumn &other, size_t j)
+{
+    mpn_copyi(this->data(i), other.data(j), CIPHER_LIMBS);
+}
+
+void CipherColumn::homo_add(const JL_PK &jl_pk, size_t i, const mpz_class &right)
+{
+    mp_limb_t tmp[CIPHER_LIMBS];
+    store_limbs(tmp, right.get_mpz_t());
+    add_limbs(this->data(i), tmp, jl_pk);
+}
+
+void CipherColumn::homo_add(const JL_PK &jl_pk, size_t i, const CipherColumn &other, size_t j)
+{
+    add_limbs(this->data(i), other.data(j), jl_pk);
+}
+
+void CipherColumn::homo_sub(const JL_PK &jl_pk, size_t i, const mpz_class &right)
+{
+    mp_limb_t tmp[CIPHER_LIMBS];
+    store_limbs(tmp, right.get_mpz_t());
+    sub_limbs(this->data(i), tmp, jl_pk);
+}
+
+void CipherColumn::homo_sub(const JL_PK &jl_pk, size_t i, const CipherColumn &other, size_t j)
+{
+    sub_limbs(this->data(i), other.data(j), jl_pk);
+}
+
+void CipherColumn::homo_mul(const JL_PK &jl_pk, size_t i, const mpz_class &scalar)
+{
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    mp_limb_t tmp[CIPHER_LIMBS];
+    store_limbs(tmp, scalar.get_mpz_t());
+    mul_mod(this->data(i), this->data(i), tmp, jl_pk);
+#else
+    mpz_t view, result;
+    mpz_init2(result, JL_MODULUS);
+    mpz_powm(result, mpz_roinit_n(view, this->data(i), CIPHER_LIMBS), scalar.get_mpz_t(), jl_pk.N.get_mpz_t());
+    store_limbs(this->data(i), result);
+    mpz_clear(result);
+#endif
+}
+
+void CipherColumn::homo_sum(const JL_PK &jl_pk, size_t begin, size_t end, mpz_class &out) const
+{
+    mp_limb_t acc[CIPHER_LIMBS];
+    store_limbs(acc, out.get_mpz_t());
+    for (size_t i = begin; i < end; i++)
+    {
+        add_limbs(acc, this->data(i), jl_pk);
+    }
+    load_limbs(out.get_mpz_t(), acc);
+}
@@ -0,0 +1,239 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+
+#include "contraction.hpp"
+
+using namespace std;
+
+namespace
+{
+    typedef pair<size_t, uint32_t> QUEUE_ITEM;
+    typedef unordered_map<uint32_t, size_t> ADJ;
+
+    // Vertices a witness search settles before it gives up, a shortcut is
+    // added then. Only makes the hierarchy larger, never wrong.
+    const size_t WITNESS_SETTLE_LIMIT = 256;
+
+    /**
+     * The graph being contracted, parallel edges keep the lightest weight.
+    */
+    class Contractor
+    {
+      public:
+        vector<ADJ> out;
+        vector<ADJ> in;
+        vector<char> contracted;
+        vector<uint32_t> contracted_neighbors;
+
+        explicit Contractor(const CSRGraph<size_t> &graph)
+            : out(graph.num_vertices()), in(graph.num_vertices()),
+              contracted(graph.num_vertices(), 0), contracted_neighbors(graph.num_vertices(), 0)
+        {
+            for (uint32_t u = 0; u < graph.num_vertices(); u++)
+            {
+                for (size_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++)
+                {
+                    this->add_edge(u, graph.targets[e], graph.weights[e]);
+                }
+            }
+        }
+
+        void add_edge(uint32_t u, uint32_t v, size_t w)
+        {
+            if (u == v) { return; }
+            auto it = this->out[u].find(v);
+            if (it != this->out[u].end() && it->second <= w) { return; }
+            this->out[u][v] = w;
+            this->in[v][u] = w;
+        }
+
+        /**
+         * Distances from u to the targets without going through skip, up
+         * to max_dist. dist and visited are scratch, reset on return by the
+         * caller through visited.
+        */
+        void witness_search(uint32_t u, uint32_t skip, size_t max_dist, vector<size_t> &dist, vector<uint32_t> &visited)
+        {
+            priority_queue<QUEUE_ITEM, vector<QUEUE_ITEM>, greater<QUEUE_ITEM>> q;
+            dist[u] = 0;
+            visited.push_back(u);
+            q.push(QUEUE_ITEM(0, u));
+            size_t settled = 0;
+            while (!q.empty() && settled < WITNESS_SETTLE_LIMIT)
+            {
+                size_t d = q.top().first;
+                uint32_t x = q.top().second;
+                q.pop();
+                if (d > dist[x]) { continue; }
+                if (d > max_dist) { break; }
+                settled++;
+                for (auto &e : this->out[x])
+                {
+                    if (e.first == skip) { continue; }
+                    if (d + e.second < dist[e.first])
+                    {
+                        if (dist[e.first] == CH_NO_PATH) { visited.push_back(e.first); }
+                        dist[e.first] = d + e.second;
+                        q.push(QUEUE_ITEM(d + e.second, e.first));
+                    }
+                }
+            }
+        }
+
+        /**
+         * Shortcuts needed to contract v, added to shortcuts unless null.
+        */
+        size_t shortcuts(uint32_t v, vector<size_t> &dist, vector<uint32_t> &visited,
+                         vector<pair<pair<uint32_t, uint32_t>, size_t>> *shortcuts)
+        {
+            size_t max_out = 0;
+            for (auto &e : this->out[v]) { max_out = max(max_out, e.second); }
+
+            size_t num = 0;
+            for (auto &in_e : this->in[v])
+            {
+                uint32_t u = in_e.first;
+                this->witness_search(u, v, in_e.second + max_out, dist, visited);
+                for (auto &out_e : this->out[v])
+                {
+                    uint32_t x = out_e.first;
+                    if (x == u) { continue; }
+                    if (dist[x] > in_e.second + out_e.second)
+                    {
+                        num++;
+                        if (shortcuts != nullptr)
+                        {
+                            shortcuts->push_back(make_pair(make_pair(u, x), in_e.second + out_e.second));
+                        }
+                    }
+                }
+                for (auto x : visited) { dist[x] = CH_NO_PATH; }
+                visited.clear();
+            }
+            return num;
+        }
+
+        long long priority(uint32_t v, vector<size_t> &dist, vector<uint32_t> &visited)
+        {
+            long long added = (long long)this->shortcuts(v, dist, visited, nullptr);
+            long long removed = (long long)(this->in[v].size() + this->out[v].size());
+            return added - removed + (long long)this->contracted_neighbors[v];
+        }
+    };
+
+    void upward_search(const vector<vector<CH_EDGE>> &edges, uint32_t s, unordered_map<uint32_t, size_t> &dist)
+    {
+        priority_queue<QUEUE_ITEM, vector<QUEUE_ITEM>, greater<QUEUE_ITEM>> q;
+        dist[s] = 0;
+        q.push(QUEUE_ITEM(0, s));
+        while (!q.empty())
+        {
+            size_t d = q.top().first;
+            uint32_t u = q.top().second;
+            q.pop();
+            if (d > dist[u]) { continue; }
+            for (auto &e : edges[u])
+            {
+                auto it = dist.find(e.v);
+                if (it == dist.end() || d + e.weight < it->second)
+                {
+                    dist[e.v] = d + e.weight;
+                    q.push(QUEUE_ITEM(d + e.weight, e.v));
+                }
+            }
+        }
+    }
+} // namespace
+
+bool build_contraction_hierarchy(const CSRGraph<size_t> &graph, CH_GRAPH &ch)
+{
+    size_t n = graph.num_vertices();
+    if (graph.rev_offsets.size() != n + 1)
+    {
+        cerr << "Contraction needs the reverse CSR of the graph!" << endl;
+        return false;
+    }
+
+    Contractor con(graph);
+    ch.rank.assign(n, 0);
+    ch.up.assign(n, vector<CH_EDGE>());
+    ch.down.assign(n, vector<CH_EDGE>());
+    ch.num_shortcuts = 0;
+
+    vector<size_t> dist(n, CH_NO_PATH);
+    vector<uint32_t> visited;
+
+    typedef pair<long long, uint32_t> ORDER_ITEM;
+    priority_queue<ORDER_ITEM, vector<ORDER_ITEM>, greater<ORDER_ITEM>> order;
+    for (uint32_t v = 0; v < n; v++)
+    {
+        order.push(ORDER_ITEM(con.priority(v, dist, visited), v));
+    }
+
+    vector<pair<pair<uint32_t, uint32_t>, size_t>> shortcuts;
+    uint32_t next_rank = 0;
+    while (!order.empty())
+    {
+        uint32_t v = order.top().second;
+        order.pop();
+        if (con.contracted[v]) { continue; }
+
+        // Lazy update, the priority may have grown since it was pushed.
+        long long prio = con.priority(v, dist, visited);
+        if (!order.empty() && prio > order.top().first)
+        {
+            order.push(ORDER_ITEM(prio, v));
+            continue;
+        }
+
+        // Every remaining neighbor is contracted later, so ranks higher.
+        for (auto &e : con.out[v]) { ch.up[v].push_back(CH_EDGE{e.first, e.second}); }
+        for (auto &e : con.in[v]) { ch.down[v].push_back(CH_EDGE{e.first, e.second}); }
+
+        shortcuts.clear();
+        con.shortcuts(v, dist, visited, &shortcuts);
+        for (auto &sc : shortcuts)
+        {
+            con.add_edge(sc.first.first, sc.first.second, sc.second);
+        }
+        ch.num_shortcuts += shortcuts.size();
+
+        for (auto &e : con.out[v])
+        {
+            con.in[e.first].erase(v);
+            con.contracted_neighbors[e.first]++;
+        }
+        for (auto &e : con.in[v])
+        {
+            con.out[e.first].erase(v);
+            con.contracted_neighbors[e.first]++;
+        }
+        con.out[v].clear();
+        con.in[v].clear();
+        con.contracted[v] = 1;
+        ch.rank[v] = next_rank++;
+    }
+    return true;
+}
+
+size_t ch_distance(const CH_GRAPH &ch, uint32_t s, uint32_t t)
+{
+    unordered_map<uint32_t, size_t> forward, backward;
+    upward_search(ch.up, s, forward);
+    upward_search(ch.down, t, backward);
+
+    size_t best = CH_NO_PATH;
+    for (auto &f : forward)
+    {
+        auto it = backward.find(f.first);
+        if (it != backward.end())
+        {
+            best = min(best, f.second + it->second);
+        }
+    }
+    return best;
+}
@@ -1,9 +1,16 @@
 // g++ crypto_stuff.cpp -g ../labhe/build/liblabhe.a -I ../labhe/include/ -I ../include/ -lgmpxx -lgmp -lcrypto -D SEC_GDB_DBG_CRYPTO
 
+// The SHA state has to be copied for edge_token, which only the low
+// level interface allows.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
 #include <iostream>
 #include <fstream>
 #include <gmpxx.h>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 
 #include "global.h"
 #include "crypto_stuff.hpp"
@@ -19,6 +26,25 @@ extern "C"
 
 #include <openssl/sha.h>
 
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#ifdef SEC_GDB_AES_PRF
+#ifndef __AES__
+#error "SEC_GDB_AES_PRF needs AES-NI, build with -maes"
+#endif
+#include <wmmintrin.h>
+#endif
+
+#ifdef SEC_GDB_KECCAK_TOKEN
+extern "C"
+{
+#include "KeccakP-1600-SnP.h"
+#include "KeccakP-1600-times4-SnP.h"
+}
+#endif
+
 using namespace std;
 
 /**
@@ -59,33 +85,189 @@ void set_mpz_raw(mpz_ptr dest, size_t size, const void* buff)
                 WRAPPING_GMP_EXPORT_FORMAT_ENDIAN, WRAPPING_GMP_EXPORT_FORMAT_NAIL, buff);
 }
 
+#ifdef SEC_GDB_KECCAK_TOKEN
+
+// One block holds F_1(u), QT_i and the padding, so a token is one call
+// of the 12 rounds permutation, as TurboSHAKE128 (TurboSHAKE256 at the
+// 256 bits level).
+#ifdef SECURITY_LEVEL_128
+#define EDGE_TOKEN_RATE 168
+#else
+#define EDGE_TOKEN_RATE 136
+#endif
+
+// Domain separation byte of the edge tokens.
+#define EDGE_TOKEN_DOMAIN 0x0B
+
+void edge_token_init(EDGE_TOKEN_CTX &ctx, const unsigned char *F_1_u, size_t key_size)
+{
+    KeccakP1600_StaticInitialize();
+    KeccakP1600times4_StaticInitialize();
+
+    ctx.key_size = (key_size > KEY_SIZE) ? KEY_SIZE : key_size;
+    memcpy(ctx.key, F_1_u, ctx.key_size);
+}
+
 /**
- * Hash function which is used in paper.
+ * TurboSHAKE(F_1(u) || QT_i), out gets UT_i and then the mask used to
+ * blind the edge, EDGE_TOKEN_SIZE bytes in total.
 */
-void H_1(unsigned char *key, size_t key_size, unsigned char *in, size_t data_size, unsigned char *out)
+void edge_token(const EDGE_TOKEN_CTX &ctx, const unsigned char *sub_key, size_t sub_key_size, unsigned char *out)
 {
-    int rtn_size;
+    alignas(KeccakP1600_stateAlignment) unsigned char state[KeccakP1600_stateSizeInBytes];
+    KeccakP1600_Initialize(state);
+
+    unsigned int pos = 0;
+    auto absorb = [&state, &pos](const unsigned char *data, size_t size) {
+        while (size > 0)
+        {
+            unsigned int len = (unsigned int)std::min<size_t>(size, EDGE_TOKEN_RATE - pos);
+            KeccakP1600_AddBytes(state, data, pos, len);
+            pos += len;
+            data += len;
+            size -= len;
+            if (pos == EDGE_TOKEN_RATE)
+            {
+                KeccakP1600_Permute_12rounds(state);
+                pos = 0;
+            }
+        }
+    };
+    absorb(ctx.key, ctx.key_size);
+    absorb(sub_key, sub_key_size);
+
+    KeccakP1600_AddByte(state, EDGE_TOKEN_DOMAIN, pos);
+    KeccakP1600_AddByte(state, 0x80, EDGE_TOKEN_RATE - 1);
+    KeccakP1600_Permute_12rounds(state);
+    KeccakP1600_ExtractBytes(state, out, 0, EDGE_TOKEN_SIZE);
+}
+
+/**
+ * Tokens of the sibling sub keys of a vertex, out gets num tokens back to
+ * back. Four sponges run side by side in KeccakP-1600-times4, which is
+ * SIMD on the targets of the code package that have it.
+*/
+void edge_tokens(const EDGE_TOKEN_CTX &ctx, char *const *sub_keys, size_t num, size_t sub_key_size, unsigned char *out)
+{
+    size_t i = 0;
+    if (ctx.key_size + sub_key_size < EDGE_TOKEN_RATE)
+    {
+        unsigned int msg_size = (unsigned int)(ctx.key_size + sub_key_size);
+        alignas(KeccakP1600times4_statesAlignment) unsigned char states[KeccakP1600times4_statesSizeInBytes];
+
+        for (; i + 4 <= num; i += 4)
+        {
+            KeccakP1600times4_InitializeAll(states);
+            for (unsigned int k = 0; k < 4; k++)
+            {
+                KeccakP1600times4_AddBytes(states, k, ctx.key, 0, (unsigned int)ctx.key_size);
+                KeccakP1600times4_AddBytes(states, k, (const unsigned char*)sub_keys[i + k], (unsigned int)ctx.key_size,
+                                           (unsigned int)sub_key_size);
+                KeccakP1600times4_AddByte(states, k, EDGE_TOKEN_DOMAIN, msg_size);
+                KeccakP1600times4_AddByte(states, k, 0x80, EDGE_TOKEN_RATE - 1);
+            }
+            KeccakP1600times4_PermuteAll_12rounds(states);
+            for (unsigned int k = 0; k < 4; k++)
+            {
+                KeccakP1600times4_ExtractBytes(states, k, out + (i + k) * EDGE_TOKEN_SIZE, 0, EDGE_TOKEN_SIZE);
+            }
+        }
+    }
+
+    for (; i < num; i++)
+    {
+        edge_token(ctx, (const unsigned char*)sub_keys[i], sub_key_size, out + i * EDGE_TOKEN_SIZE);
+    }
+}
+
+#else // SEC_GDB_KECCAK_TOKEN
+
 #ifdef SECURITY_LEVEL_128
-    HMAC(EVP_sha1(), key, (int)key_size, in, data_size, out, (unsigned int *)&rtn_size);
+#define EDGE_TOKEN_BLOCK SHA256_CBLOCK
+#define EDGE_TOKEN_INIT SHA256_Init
+#define EDGE_TOKEN_UPDATE SHA256_Update
+#define EDGE_TOKEN_FINAL SHA256_Final
 #else
-    HMAC(EVP_sha256(), key, (int)key_size, in, data_size, out, (unsigned int *)&rtn_size);
+#define EDGE_TOKEN_BLOCK SHA512_CBLOCK
+#define EDGE_TOKEN_INIT SHA512_Init
+#define EDGE_TOKEN_UPDATE SHA512_Update
+#define EDGE_TOKEN_FINAL SHA512_Final
 #endif
+
+/**
+ * Hash the HMAC pads of F_1(u) once, so the tokens of the out edges of u
+ * only hash their sub keys.
+*/
+void edge_token_init(EDGE_TOKEN_CTX &ctx, const unsigned char *F_1_u, size_t key_size)
+{
+    unsigned char block[EDGE_TOKEN_BLOCK] = {0};
+    if (key_size > EDGE_TOKEN_BLOCK)
+    {
+        EDGE_TOKEN_INIT(&ctx.inner);
+        EDGE_TOKEN_UPDATE(&ctx.inner, F_1_u, key_size);
+        EDGE_TOKEN_FINAL(block, &ctx.inner);
+    }
+    else
+    {
+        memcpy(block, F_1_u, key_size);
+    }
+
+    unsigned char pad[EDGE_TOKEN_BLOCK];
+    for (size_t i = 0; i < EDGE_TOKEN_BLOCK; i++) { pad[i] = block[i] ^ 0x36; }
+    EDGE_TOKEN_INIT(&ctx.inner);
+    EDGE_TOKEN_UPDATE(&ctx.inner, pad, EDGE_TOKEN_BLOCK);
+
+    for (size_t i = 0; i < EDGE_TOKEN_BLOCK; i++) { pad[i] = block[i] ^ 0x5c; }
+    EDGE_TOKEN_INIT(&ctx.outer);
+    EDGE_TOKEN_UPDATE(&ctx.outer, pad, EDGE_TOKEN_BLOCK);
 }
 
 /**
- * Hash function which is used in paper.
- * Same function,
+ * HMAC(F_1(u), QT_i) in one pass, out gets UT_i and then the mask used to
+ * blind the edge, EDGE_TOKEN_SIZE bytes in total. It stands for H_1 and
+ * H_2 of the paper.
 */
-void H_2(unsigned char *key, size_t key_size, unsigned char *in, size_t data_size, unsigned char *out)
+void edge_token(const EDGE_TOKEN_CTX &ctx, const unsigned char *sub_key, size_t sub_key_size, unsigned char *out)
 {
-    string str = string((char *)key, key_size);
-    std::reverse(str.begin(), str.end());
-#ifdef NOT_SAME_HASH
-    //Nee a alternative hash algorithm.
-    //Have no idea currently....
-#else
-    H_1((unsigned char*)str.c_str(), key_size, in, data_size, out);
-#endif
+    unsigned char digest[EDGE_TOKEN_SIZE];
+
+    EDGE_TOKEN_CTX tmp = ctx;
+    EDGE_TOKEN_UPDATE(&tmp.inner, sub_key, sub_key_size);
+    EDGE_TOKEN_FINAL(digest, &tmp.inner);
+
+    EDGE_TOKEN_UPDATE(&tmp.outer, digest, sizeof(digest));
+    EDGE_TOKEN_FINAL(out, &tmp.outer);
+}
+
+/**
+ * Tokens of the sibling sub keys of a vertex, out gets num tokens back to
+ * back.
+*/
+void edge_tokens(const EDGE_TOKEN_CTX &ctx, char *const *sub_keys, size_t num, size_t sub_key_size, unsigned char *out)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        edge_token(ctx, (const unsigned char*)sub_keys[i], sub_key_size, out + i * EDGE_TOKEN_SIZE);
+    }
+}
+
+#endif // SEC_GDB_KECCAK_TOKEN
+
+/**
+ * Token of entry i of a list of a vertex (hub labels, landmark distances,
+ * hierarchy edges), ctx is keyed by its F_1. The sub key is dir, i in
+ * little endian and zeros, GGM sub keys are random so the tokens do not
+ * run into edge tokens.
+*/
+void label_token(const EDGE_TOKEN_CTX &ctx, char dir, uint32_t i, unsigned char *out)
+{
+    unsigned char sub_key[KEY_SIZE] = {0};
+    sub_key[0] = (unsigned char)dir;
+    for (int b = 0; b < 4; b++)
+    {
+        sub_key[1 + b] = (unsigned char)(i >> (8 * b));
+    }
+    edge_token(ctx, sub_key, KEY_SIZE, out);
 }
 
 /**
@@ -110,6 +292,222 @@ size_t F(unsigned char *key, size_t key_size, unsigned char *in, size_t data_siz
     return rtn_size;
 }
 
+#ifdef SEC_GDB_AES_PRF
+
+namespace
+{
+    // Messages hashed side by side, enough to keep the AES unit busy.
+    const size_t AES_PRF_LANES = 8;
+
+    // Output blocks of F, each one is a CBC-MAC with its own first block.
+    const size_t AES_PRF_PARTS = KEY_SIZE / 16;
+
+    inline __m128i expand_key(__m128i key, __m128i gen)
+    {
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, gen);
+    }
+
+#define AES_EXPAND_EVEN(i, rcon) \
+    rk[i] = expand_key(rk[(i) - KEY_SIZE / 16], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[(i) - 1], rcon), 0xff))
+#define AES_EXPAND_ODD(i) \
+    rk[i] = expand_key(rk[(i) - 2], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[(i) - 1], 0x00), 0xaa))
+
+    void aes_expand(const unsigned char *key, __m128i *rk)
+    {
+        rk[0] = _mm_loadu_si128((const __m128i *)key);
+#ifdef SECURITY_LEVEL_128
+        AES_EXPAND_EVEN(1, 0x01); AES_EXPAND_EVEN(2, 0x02); AES_EXPAND_EVEN(3, 0x04);
+        AES_EXPAND_EVEN(4, 0x08); AES_EXPAND_EVEN(5, 0x10); AES_EXPAND_EVEN(6, 0x20);
+        AES_EXPAND_EVEN(7, 0x40); AES_EXPAND_EVEN(8, 0x80); AES_EXPAND_EVEN(9, 0x1b);
+        AES_EXPAND_EVEN(10, 0x36);
+#else
+        rk[1] = _mm_loadu_si128((const __m128i *)(key + 16));
+        AES_EXPAND_EVEN(2, 0x01); AES_EXPAND_ODD(3);
+        AES_EXPAND_EVEN(4, 0x02); AES_EXPAND_ODD(5);
+        AES_EXPAND_EVEN(6, 0x04); AES_EXPAND_ODD(7);
+        AES_EXPAND_EVEN(8, 0x08); AES_EXPAND_ODD(9);
+        AES_EXPAND_EVEN(10, 0x10); AES_EXPAND_ODD(11);
+        AES_EXPAND_EVEN(12, 0x20); AES_EXPAND_ODD(13);
+        AES_EXPAND_EVEN(14, 0x40);
+#endif
+    }
+
+#undef AES_EXPAND_EVEN
+#undef AES_EXPAND_ODD
+
+    // Encrypt n <= AES_PRF_LANES blocks, interleaved so the rounds of
+    // different blocks overlap in the pipeline.
+    inline void aes_encrypt_blocks(const __m128i *rk, __m128i *x, size_t n)
+    {
+        for (size_t l = 0; l < n; l++) { x[l] = _mm_xor_si128(x[l], rk[0]); }
+        for (int r = 1; r < AES_PRF_ROUNDS; r++)
+        {
+            for (size_t l = 0; l < n; l++) { x[l] = _mm_aesenc_si128(x[l], rk[r]); }
+        }
+        for (size_t l = 0; l < n; l++) { x[l] = _mm_aesenclast_si128(x[l], rk[AES_PRF_ROUNDS]); }
+    }
+
+    // Block b of a message, the last one zero padded.
+    inline __m128i load_block(const unsigned char *in, size_t size, size_t b)
+    {
+        if ((b + 1) * 16 <= size)
+        {
+            return _mm_loadu_si128((const __m128i *)(in + b * 16));
+        }
+        unsigned char tmp[16] = {0};
+        memcpy(tmp, in + b * 16, size - b * 16);
+        return _mm_loadu_si128((const __m128i *)tmp);
+    }
+
+    typedef struct _PRF_LANE
+    {
+        const unsigned char *in;
+        size_t size;
+        unsigned char *out;
+    } PRF_LANE;
+
+    /**
+     * CBC-MAC of each lane with the length and the output part as first
+     * block. The length prefix makes the inputs prefix free, which is what
+     * CBC-MAC needs to be a PRF on names of any length.
+     * Lanes are processed AES_PRF_LANES (message, part) pairs at a time.
+    */
+    void aes_prf_lanes(const PRF_KEY &key, const PRF_LANE *lanes, size_t num)
+    {
+        __m128i rk[AES_PRF_ROUNDS + 1];
+        for (int r = 0; r <= AES_PRF_ROUNDS; r++)
+        {
+            rk[r] = _mm_loadu_si128((const __m128i *)(key.rk + r * 16));
+        }
+
+        size_t jobs = num * AES_PRF_PARTS;
+        __m128i state[AES_PRF_LANES], active[AES_PRF_LANES];
+        size_t which[AES_PRF_LANES];
+
+        for (size_t first = 0; first < jobs; first += AES_PRF_LANES)
+        {
+            size_t n = std::min(AES_PRF_LANES, jobs - first);
+            size_t max_blocks = 0;
+            for (size_t l = 0; l < n; l++)
+            {
+                const PRF_LANE &lane = lanes[(first + l) / AES_PRF_PARTS];
+                state[l] = _mm_set_epi64x((long long)((first + l) % AES_PRF_PARTS), (long long)lane.size);
+                max_blocks = std::max(max_blocks, (lane.size + 15) / 16);
+            }
+            aes_encrypt_blocks(rk, state, n);
+
+            // Names differ in length, lanes that are done sit out.
+            for (size_t b = 0; b < max_blocks; b++)
+            {
+                size_t m = 0;
+                for (size_t l = 0; l < n; l++)
+                {
+                    const PRF_LANE &lane = lanes[(first + l) / AES_PRF_PARTS];
+                    if (b * 16 < lane.size)
+                    {
+                        active[m] = _mm_xor_si128(state[l], load_block(lane.in, lane.size, b));
+                        which[m++] = l;
+                    }
+                }
+                aes_encrypt_blocks(rk, active, m);
+                for (size_t j = 0; j < m; j++) { state[which[j]] = active[j]; }
+            }
+
+            for (size_t l = 0; l < n; l++)
+            {
+                const PRF_LANE &lane = lanes[(first + l) / AES_PRF_PARTS];
+                _mm_storeu_si128((__m128i *)(lane.out + ((first + l) % AES_PRF_PARTS) * 16), state[l]);
+            }
+        }
+    }
+} // namespace
+
+void prf_key_init(PRF_KEY &key, const string &k)
+{
+    // k is exported from a mpz and may be short by its leading zeros.
+    unsigned char raw[KEY_SIZE] = {0};
+    memcpy(raw, k.data(), std::min(k.size(), (size_t)KEY_SIZE));
+
+    __m128i rk[AES_PRF_ROUNDS + 1];
+    aes_expand(raw, rk);
+    for (int r = 0; r <= AES_PRF_ROUNDS; r++)
+    {
+        _mm_storeu_si128((__m128i *)(key.rk + r * 16), rk[r]);
+    }
+}
+
+/**
+ * Length prefixed AES CBC-MAC, KEY_SIZE bytes of output.
+*/
+size_t F(const PRF_KEY &key, const unsigned char *in, size_t data_size, unsigned char *out)
+{
+    PRF_LANE lane = {in, data_size, out};
+    aes_prf_lanes(key, &lane, 1);
+    return KEY_SIZE;
+}
+
+/**
+ * F of num names, out gets num * KEY_SIZE bytes.
+*/
+void F_batch(const PRF_KEY &key, const string *in, size_t num, unsigned char *out)
+{
+    PRF_LANE lanes[AES_PRF_LANES];
+    for (size_t first = 0; first < num; first += AES_PRF_LANES)
+    {
+        size_t n = std::min(AES_PRF_LANES, num - first);
+        for (size_t i = 0; i < n; i++)
+        {
+            const string &name = in[first + i];
+            lanes[i] = PRF_LANE{(const unsigned char *)name.data(), name.size(), out + (first + i) * KEY_SIZE};
+        }
+        aes_prf_lanes(key, lanes, n);
+    }
+}
+
+#else
+
+void prf_key_init(PRF_KEY &key, const string &k)
+{
+    key.key = k;
+}
+
+/**
+ * F with a prepared key, always KEY_SIZE bytes of output.
+*/
+size_t F(const PRF_KEY &key, const unsigned char *in, size_t data_size, unsigned char *out)
+{
+#ifdef F_FUNCTION_DISABLE
+    memset(out, 0, KEY_SIZE);
+    memcpy(out, in, std::min(data_size, (size_t)KEY_SIZE));
+#else
+    // The digest can be longer than KEY_SIZE (SHA1 at the 128-bit level).
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    F((unsigned char *)key.key.data(), key.key.size(), (unsigned char *)in, data_size, digest);
+    memcpy(out, digest, KEY_SIZE);
+#endif
+    return KEY_SIZE;
+}
+
+void F_batch(const PRF_KEY &key, const string *in, size_t num, unsigned char *out)
+{
+    for (size_t i = 0; i < num; i++)
+    {
+        F(key, (const unsigned char *)in[i].data(), in[i].size(), out + i * KEY_SIZE);
+    }
+}
+
+#endif // SEC_GDB_AES_PRF
+
+void sk_expand(SK &sk)
+{
+    prf_key_init(sk.f_1, sk.k_1);
+    prf_key_init(sk.f_2, sk.k_2);
+    prf_key_init(sk.f_3, sk.k_3);
+}
+
 /**
  * This function is used to generate the SK to be used.
 */
@@ -161,6 +559,8 @@ bool sample_key(SK &sk, PK &pk)
     mpz_urandomb(k3.get_mpz_t(), rand_st, SECURITY_LEVEL);
     sk.k_3 = let_mpz_raw_to_str(k3.get_mpz_t());
 
+    sk_expand(sk);
+
     gmp_randclear(rand_st);
 
     return true;
@@ -183,14 +583,12 @@ void pk_clear(PK &pk)
 }
 
 /**
- * A wrapped JL scheme encryption algorithm.
- * Yeah... the last one is the return value.. History....
+ * Seed a GMP random state from /dev/urandom.
+ * Workers keep one seeded state each instead of reopening the random
+ * source for every encryption.
 */
-void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out)
+void seed_rand_state(gmp_randstate_t rand_st)
 {
-#ifdef SEC_GDB_WITHOUT_ENCRYPTION
-    out = in;
-#else
     mpz_class seed;
     unsigned char rand_buff[KEY_SIZE] = {0};
     ifstream in_file("/dev/urandom");
@@ -210,17 +608,42 @@ void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out)
     }
     mpz_import(seed.get_mpz_t(), sizeof(rand_buff), 1, sizeof(rand_buff[0]), 0, 0, rand_buff);
 
+    gmp_randseed(rand_st, seed.get_mpz_t());
+}
+
+/**
+ * A wrapped JL scheme encryption algorithm.
+ * Yeah... the last one is the return value.. History....
+*/
+void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out)
+{
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    out = in;
+#else
     gmp_randstate_t rand_st;
     gmp_randinit_default(rand_st);
-    gmp_randseed(rand_st, seed.get_mpz_t());
+    seed_rand_state(rand_st);
 
-    bhjl_encrypt(out.get_mpz_t(), in.get_mpz_t(), jl_pk.N.get_mpz_t(),
-                jl_pk.y.get_mpz_t(), SECURITY_LEVEL, jl_pk._2k.get_mpz_t(), rand_st);
+    JL_encryption(jl_pk, in, out, rand_st);
     
     gmp_randclear(rand_st);
 #endif
 }
 
+/**
+ * Same as above but draws the randomness from a caller-owned state,
+ * which has to be seeded already.
+*/
+void JL_encryption(JL_PK &jl_pk, mpz_class &in, mpz_class &out, gmp_randstate_t rand_st)
+{
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    out = in;
+#else
+    bhjl_encrypt(out.get_mpz_t(), in.get_mpz_t(), jl_pk.N.get_mpz_t(),
+                jl_pk.y.get_mpz_t(), SECURITY_LEVEL, jl_pk._2k.get_mpz_t(), rand_st);
+#endif
+}
+
 void JL_encryption(PK &pk, mpz_class &in, mpz_class &out)
 {
     JL_encryption(pk.jl_pk, in, out);
@@ -232,6 +655,12 @@ void JL_encryption(PK &pk, size_t num, mpz_class &out)
     JL_encryption(pk.jl_pk, tmp, out);
 }
 
+void JL_encryption(PK &pk, size_t num, mpz_class &out, gmp_randstate_t rand_st)
+{
+    mpz_class tmp(num);
+    JL_encryption(pk.jl_pk, tmp, out, rand_st);
+}
+
 /**
  * A wrapped JL scheme decryption algorithm.
 */
@@ -307,31 +736,182 @@ mpz_class JL_homo_mul(const PK &pk, const mpz_class &left, const mpz_class &righ
 }
 
 /**
- * 
+ * out = input ^ mask, the mask repeated over size bytes. out may be input.
+ * Masks of 16 or 32 bytes, which is all the edge records use, are applied
+ * 16 bytes a step with SSE2 and 32 with AVX2, the tail byte by byte.
 */
-void masking(const void* input, size_t size, unsigned char* mask, size_t mask_size, unsigned char* out)
+void masking(const void* input, size_t size, const unsigned char* mask, size_t mask_size, unsigned char* out)
 {
-    size_t round = size / mask_size;
-    size_t rest = size % mask_size;
-
-    const unsigned char* tmp = (unsigned char*)input;
+    const unsigned char* in = (const unsigned char*)input;
+    size_t i = 0;
 
-    size_t base = 0;
-    for (size_t i = 0; i < round; i++)
+#ifdef __SSE2__
+    if (mask_size == 16 || mask_size == 32)
     {
-        
-        for (size_t j = 0; j < mask_size; j++)
+#ifdef __AVX2__
+        __m256i m = (mask_size == 32) ? _mm256_loadu_si256((const __m256i*)mask)
+                                      : _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask));
+        for (; i + 32 <= size; i += 32)
         {
-            out[base + j] = tmp[base + j] ^ mask[j];
+            __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+            _mm256_storeu_si256((__m256i*)(out + i), _mm256_xor_si256(x, m));
         }
+#endif
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i m = _mm_loadu_si128((const __m128i*)(mask + i % mask_size));
+            __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+            _mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(x, m));
+        }
+    }
+#endif
+
+    for (size_t j = i % mask_size; i < size; i++)
+    {
+        out[i] = in[i] ^ mask[j];
+        if (++j == mask_size) { j = 0; }
+    }
+}
+
+// The weight of an edge record is the big endian export of the ciphertext.
+// With 64 bit limbs on a little endian host it is written and read a limb
+// at a time, byte swapped, instead of going through mpz_export/mpz_import.
+#if GMP_NUMB_BITS == 64 && GMP_NAIL_BITS == 0 && defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define EDGE_RECORD_LIMBS
+#endif
+
+/**
+ * Write the D_e record of an edge, P_v || F_1_v || weight masked with the
+ * second half of its edge token, straight into record.
+*/
+void mask_edge_record(const unsigned char* P_v, const unsigned char* F_1_v, mpz_srcptr weight,
+                      const unsigned char* mask, string& record)
+{
+    size_t w_size = (mpz_sgn(weight) == 0) ? 0 : mpz_sizeinbase(weight, 256);
+    record.resize(2 * KEY_SIZE + w_size);
+    unsigned char* dst = (unsigned char*)&record[0];
+
+    masking(P_v, KEY_SIZE, mask, KEY_SIZE, dst);
+    masking(F_1_v, KEY_SIZE, mask, KEY_SIZE, dst + KEY_SIZE);
+    dst += 2 * KEY_SIZE;
+
+#ifdef EDGE_RECORD_LIMBS
+    // The weight starts at a multiple of KEY_SIZE, byte p is masked with
+    // mask[p % KEY_SIZE]. Doubling the mask lets 8 bytes be read at once.
+    unsigned char mask2[2 * KEY_SIZE];
+    memcpy(mask2, mask, KEY_SIZE);
+    memcpy(mask2 + KEY_SIZE, mask, KEY_SIZE);
+
+    const mp_limb_t* limbs = mpz_limbs_read(weight);
+    size_t full = w_size / 8, top = w_size % 8;
+    for (size_t j = 0; j < full; j++)
+    {
+        size_t p = w_size - 8 * (j + 1);
+        uint64_t m;
+        memcpy(&m, mask2 + p % KEY_SIZE, 8);
+        uint64_t x = __builtin_bswap64(limbs[j]) ^ m;
+        memcpy(dst + p, &x, 8);
+    }
+    for (size_t k = 0; k < top; k++)
+    {
+        dst[k] = (unsigned char)(limbs[full] >> (8 * (top - 1 - k))) ^ mask[k % KEY_SIZE];
+    }
+#else
+    get_mpz_raw(dst, (mpz_ptr)weight);
+    masking(dst, w_size, mask, KEY_SIZE, dst);
+#endif
+}
 
-        base = mask_size * (i + 1);
+#ifdef EDGE_RECORD_LIMBS
+namespace
+{
+    // Unmask the w_size bytes of a weight into (w_size + 7) / 8 limbs.
+    void unmask_weight_limbs(const unsigned char* src, size_t w_size, const unsigned char* mask, mp_limb_t* limbs)
+    {
+        unsigned char mask2[2 * KEY_SIZE];
+        memcpy(mask2, mask, KEY_SIZE);
+        memcpy(mask2 + KEY_SIZE, mask, KEY_SIZE);
+
+        size_t full = w_size / 8, top = w_size % 8;
+        for (size_t j = 0; j < full; j++)
+        {
+            size_t p = w_size - 8 * (j + 1);
+            uint64_t x, m;
+            memcpy(&x, src + p, 8);
+            memcpy(&m, mask2 + p % KEY_SIZE, 8);
+            limbs[j] = __builtin_bswap64(x ^ m);
+        }
+        if (top)
+        {
+            mp_limb_t high = 0;
+            for (size_t k = 0; k < top; k++)
+            {
+                high = (high << 8) | (mp_limb_t)(src[k] ^ mask[k % KEY_SIZE]);
+            }
+            limbs[full] = high;
+        }
     }
+} // namespace
+#endif
 
-    for (size_t i = 0; i < rest; i++)
+/**
+ * Inverse of mask_edge_record, P_v and F_1_v get KEY_SIZE bytes each and
+ * the weight is unmasked into the limbs of weight.
+*/
+void unmask_edge_record(const string& record, const unsigned char* mask,
+                        unsigned char* P_v, unsigned char* F_1_v, mpz_ptr weight)
+{
+    const unsigned char* src = (const unsigned char*)record.data();
+    masking(src, KEY_SIZE, mask, KEY_SIZE, P_v);
+    masking(src + KEY_SIZE, KEY_SIZE, mask, KEY_SIZE, F_1_v);
+    src += 2 * KEY_SIZE;
+    size_t w_size = record.size() - 2 * KEY_SIZE;
+
+#ifdef EDGE_RECORD_LIMBS
+    size_t n = (w_size + 7) / 8;
+    if (n == 0)
     {
-        out[base + i] = tmp[base + i] ^ mask[i];
+        mpz_set_ui(weight, 0);
+        return;
     }
+    unmask_weight_limbs(src, w_size, mask, mpz_limbs_write(weight, n));
+    mpz_limbs_finish(weight, n);
+#else
+    vector<unsigned char> raw(w_size);
+    masking(src, w_size, mask, KEY_SIZE, raw.data());
+    set_mpz_raw(weight, w_size, raw.data());
+#endif
+}
+
+/**
+ * Same as above, but the weight goes to a fixed buffer of num_limbs limbs,
+ * zero padded, e.g. a slot of a CipherColumn.
+ * Returns false if it does not fit.
+*/
+bool unmask_edge_record(const string& record, const unsigned char* mask,
+                        unsigned char* P_v, unsigned char* F_1_v, mp_limb_t* limbs, size_t num_limbs)
+{
+    const unsigned char* src = (const unsigned char*)record.data();
+    masking(src, KEY_SIZE, mask, KEY_SIZE, P_v);
+    masking(src + KEY_SIZE, KEY_SIZE, mask, KEY_SIZE, F_1_v);
+    src += 2 * KEY_SIZE;
+    size_t w_size = record.size() - 2 * KEY_SIZE;
+
+#ifdef EDGE_RECORD_LIMBS
+    size_t n = (w_size + 7) / 8;
+    if (n > num_limbs) { return false; }
+    unmask_weight_limbs(src, w_size, mask, limbs);
+#else
+    vector<unsigned char> raw(w_size);
+    masking(src, w_size, mask, KEY_SIZE, raw.data());
+    mpz_class tmp;
+    set_mpz_raw(tmp.get_mpz_t(), w_size, raw.data());
+    size_t n = mpz_size(tmp.get_mpz_t());
+    if (n > num_limbs) { return false; }
+    if (n > 0) { mpn_copyi(limbs, mpz_limbs_read(tmp.get_mpz_t()), n); }
+#endif
+    if (n < num_limbs) { mpn_zero(limbs + n, num_limbs - n); }
+    return true;
 }
 
 
@@ -2,10 +2,16 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
-#include "graph.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#include <boost/algorithm/string.hpp>
+#include "graph.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 
@@ -15,36 +21,456 @@ Graph<T>::Graph() : vertices(), adjacency_list()
     this->num_edges = this->num_vertices = 0;
 }
 
+namespace
+{
+    // A vertex name inside the mapped file.
+    struct NAME_REF
+    {
+        const char *ptr;
+        uint32_t len;
+    };
+
+    struct NAME_REF_HASH
+    {
+        size_t operator()(const NAME_REF &r) const
+        {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ULL;
+            for (uint32_t i = 0; i < r.len; i++)
+            {
+                h ^= (unsigned char)r.ptr[i];
+                h *= 1099511628211ULL;
+            }
+            return (size_t)h;
+        }
+    };
+
+    struct NAME_REF_EQUAL
+    {
+        bool operator()(const NAME_REF &x, const NAME_REF &y) const
+        {
+            return x.len == y.len && memcmp(x.ptr, y.ptr, x.len) == 0;
+        }
+    };
+
+    // Edges found in one range of the file.
+    struct EDGE_RANGE
+    {
+        std::vector<NAME_REF> src;
+        std::vector<NAME_REF> dest;
+        std::vector<size_t> weight;
+    };
+
+    inline bool is_blank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    /**
+     * Scan the lines in [p, end), which has to start at the beginning of a
+     * line. Blank lines, comments (# or %) and lines with less than three
+     * fields are skipped.
+    */
+    void scan_edges(const char *p, const char *end, EDGE_RANGE &out)
+    {
+        while (p < end)
+        {
+            const char *eol = (const char *)memchr(p, '\n', end - p);
+            if (eol == nullptr) { eol = end; }
+
+            const char *q = p;
+            p = eol + 1;
+
+            while (q < eol && is_blank(*q)) { q++; }
+            if (q == eol || *q == '#' || *q == '%') { continue; }
+
+            NAME_REF src{q, 0};
+            while (q < eol && !is_blank(*q)) { q++; }
+            src.len = (uint32_t)(q - src.ptr);
+
+            while (q < eol && is_blank(*q)) { q++; }
+            NAME_REF dest{q, 0};
+            while (q < eol && !is_blank(*q)) { q++; }
+            dest.len = (uint32_t)(q - dest.ptr);
+
+            while (q < eol && is_blank(*q)) { q++; }
+            bool neg = false;
+            if (q < eol && (*q == '-' || *q == '+')) { neg = *q == '-'; q++; }
+            if (dest.len == 0 || q == eol || *q < '0' || *q > '9') { continue; }
+
+            uint64_t weight = 0;
+            while (q < eol && *q >= '0' && *q <= '9')
+            {
+                weight = weight * 10 + (uint64_t)(*q - '0');
+                q++;
+            }
+
+            out.src.push_back(src);
+            out.dest.push_back(dest);
+            // Same as the cast of stoi the line based reader used to do.
+            out.weight.push_back(neg ? (size_t)(-(int64_t)weight) : (size_t)weight);
+        }
+    }
+
+    const char EDGE_LIST_MAGIC[8] = {'S', 'G', 'D', 'B', 'E', 'D', 'G', '2'};
+
+    // Size and modification time of the graph file a cache was made from.
+    // An edit within the same second as the cache still changes the size
+    // in all but rare cases.
+    struct SOURCE_STAMP
+    {
+        uint64_t size;
+        int64_t mtime;
+    };
+
+    bool source_stamp(const string &file_path, SOURCE_STAMP &stamp)
+    {
+        struct stat st;
+        if (stat(file_path.c_str(), &st) != 0)
+        {
+            return false;
+        }
+        stamp.size = (uint64_t)st.st_size;
+        stamp.mtime = (int64_t)st.st_mtime;
+        return true;
+    }
+} // namespace
+
 /**
- * Read graph from file.
- * The format of graph should be:
- * Vertex Vertex Weight
- * the frist Vertex denote the source and the second is the destination.
- * Weight should be a interger more than 0.
- */
-void build_graph(Graph<size_t> &graph, const string &file_path)
+ * Parse a graph file into an edge list.
+ * The file is mapped and cut into one range per thread at line boundaries.
+ * Every range is scanned in place, then vertex names are interned in file
+ * order, so the ids do not depend on the number of threads.
+*/
+bool parse_edge_list(const string &file_path, EDGE_LIST &edges, int threads)
 {
-    ifstream in_file(file_path, std::ifstream::in);
-    string line;
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
 
-    
-    if (in_file.fail()) {
-        std::cout << "Read graph file failed!\n";
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
     }
 
-    while (std::getline(in_file, line))
+    edges = EDGE_LIST();
+    size_t size = (size_t)st.st_size;
+    if (size == 0)
     {
-        vector<string> strs;
+        close(fd);
+        return true;
+    }
 
-        boost::split(strs, line, boost::is_any_of(" "));
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
 
-        size_t weight = (size_t)std::stoi(strs[2]);
+    const char *begin = (const char *)mapped;
+    const char *end = begin + size;
 
-        graph.add_edge(strs[0], strs[1], weight);
+    ThreadPool pool(threads);
+    size_t parts = (size_t)pool.size();
 
+    vector<const char *> cuts(parts + 1, end);
+    cuts[0] = begin;
+    for (size_t i = 1; i < parts; i++)
+    {
+        // Move the cut past the end of the line it falls in.
+        const char *cut = std::max(cuts[i - 1], begin + size / parts * i);
+        const char *eol = (const char *)memchr(cut, '\n', end - cut);
+        cuts[i] = eol == nullptr ? end : eol + 1;
     }
 
-    in_file.close();
+    vector<EDGE_RANGE> ranges(parts);
+    for (size_t i = 0; i < parts; i++)
+    {
+        // A rough guess of 16 bytes per line saves most of the regrowing.
+        size_t guess = (size_t)(cuts[i + 1] - cuts[i]) / 16;
+        ranges[i].src.reserve(guess);
+        ranges[i].dest.reserve(guess);
+        ranges[i].weight.reserve(guess);
+    }
+
+    pool.parallel_for(parts, 1, [&](size_t b, size_t e, int) {
+        for (size_t i = b; i < e; i++)
+        {
+            scan_edges(cuts[i], cuts[i + 1], ranges[i]);
+        }
+    });
+
+    size_t total = 0;
+    for (auto &r : ranges) { total += r.src.size(); }
+
+    edges.src.reserve(total);
+    edges.dest.reserve(total);
+    edges.weight.reserve(total);
+
+    unordered_map<NAME_REF, uint32_t, NAME_REF_HASH, NAME_REF_EQUAL> ids;
+    ids.reserve(total / 4 + 16);
+    auto intern = [&](const NAME_REF &r) -> uint32_t {
+        auto it = ids.find(r);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+        uint32_t id = (uint32_t)edges.names.size();
+        edges.names.emplace_back(r.ptr, r.len);
+        ids.emplace(r, id);
+        return id;
+    };
+
+    for (auto &r : ranges)
+    {
+        for (size_t i = 0; i < r.src.size(); i++)
+        {
+            edges.src.push_back(intern(r.src[i]));
+            edges.dest.push_back(intern(r.dest[i]));
+        }
+        edges.weight.insert(edges.weight.end(), r.weight.begin(), r.weight.end());
+        r = EDGE_RANGE();
+    }
+
+    munmap(mapped, size);
+    return true;
+}
+
+string edge_list_cache_path(const string &file_path)
+{
+    return file_path + ".cache";
+}
+
+/**
+ * The cache is a magic, the size and mtime of file_path, the number of
+ * vertices and edges, the names, each with a 4 bytes length, and then the
+ * src, dest and weight arrays as they are in memory. It is meant for the
+ * machine that wrote it.
+*/
+bool save_edge_list_cache(const string &cache_path, const string &file_path, const EDGE_LIST &edges)
+{
+    SOURCE_STAMP stamp;
+    if (!source_stamp(file_path, stamp))
+    {
+        return false;
+    }
+
+    ofstream os(cache_path, ios::out | ios::binary | ios::trunc);
+    if (os.fail())
+    {
+        return false;
+    }
+
+    uint64_t num_names = edges.names.size();
+    uint64_t num_edges = edges.src.size();
+
+    os.write(EDGE_LIST_MAGIC, sizeof(EDGE_LIST_MAGIC));
+    os.write((const char *)&stamp.size, sizeof(stamp.size));
+    os.write((const char *)&stamp.mtime, sizeof(stamp.mtime));
+    os.write((const char *)&num_names, sizeof(num_names));
+    os.write((const char *)&num_edges, sizeof(num_edges));
+
+    for (auto &name : edges.names)
+    {
+        uint32_t len = (uint32_t)name.size();
+        os.write((const char *)&len, sizeof(len));
+        os.write(name.data(), len);
+    }
+
+    os.write((const char *)edges.src.data(), num_edges * sizeof(uint32_t));
+    os.write((const char *)edges.dest.data(), num_edges * sizeof(uint32_t));
+    os.write((const char *)edges.weight.data(), num_edges * sizeof(size_t));
+
+    os.close();
+    return !os.fail();
+}
+
+bool load_edge_list_cache(const string &cache_path, const string &file_path, EDGE_LIST &edges)
+{
+    SOURCE_STAMP stamp;
+    if (!source_stamp(file_path, stamp))
+    {
+        return false;
+    }
+
+    ifstream is(cache_path, ios::in | ios::binary);
+    if (is.fail())
+    {
+        return false;
+    }
+
+    char magic[sizeof(EDGE_LIST_MAGIC)];
+    SOURCE_STAMP cached = {0, 0};
+    uint64_t num_names = 0, num_edges = 0;
+
+    is.read(magic, sizeof(magic));
+    is.read((char *)&cached.size, sizeof(cached.size));
+    is.read((char *)&cached.mtime, sizeof(cached.mtime));
+    is.read((char *)&num_names, sizeof(num_names));
+    is.read((char *)&num_edges, sizeof(num_edges));
+    if (is.fail() || memcmp(magic, EDGE_LIST_MAGIC, sizeof(magic)) != 0
+        || cached.size != stamp.size || cached.mtime != stamp.mtime)
+    {
+        return false;
+    }
+
+    edges = EDGE_LIST();
+    edges.names.resize(num_names);
+    for (auto &name : edges.names)
+    {
+        uint32_t len = 0;
+        is.read((char *)&len, sizeof(len));
+        if (is.fail()) { return false; }
+        name.resize(len);
+        is.read(&name[0], len);
+    }
+
+    edges.src.resize(num_edges);
+    edges.dest.resize(num_edges);
+    edges.weight.resize(num_edges);
+    is.read((char *)edges.src.data(), num_edges * sizeof(uint32_t));
+    is.read((char *)edges.dest.data(), num_edges * sizeof(uint32_t));
+    is.read((char *)edges.weight.data(), num_edges * sizeof(size_t));
+    if (is.fail())
+    {
+        edges = EDGE_LIST();
+        return false;
+    }
+
+    for (size_t i = 0; i < num_edges; i++)
+    {
+        if (edges.src[i] >= num_names || edges.dest[i] >= num_names)
+        {
+            edges = EDGE_LIST();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Fill the graph with an edge list.
+ * Duplicated edges keep the place of the first one and the weight of the
+ * last one, which is what add_edge does, without searching the adjacency
+ * list for every edge.
+*/
+void build_graph(Graph<size_t> &graph, const EDGE_LIST &edges)
+{
+    size_t num_names = edges.names.size();
+    size_t num_edges = edges.src.size();
+
+    if (graph.num_vertices > 0)
+    {
+        // The edges may collide with the ones already in the graph.
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            string src = edges.names[edges.src[i]];
+            string dest = edges.names[edges.dest[i]];
+            size_t weight = edges.weight[i];
+            graph.add_edge(src, dest, weight);
+        }
+        return;
+    }
+
+    // Bucket the edges by source, in file order.
+    vector<size_t> offsets(num_names + 1, 0);
+    for (size_t i = 0; i < num_edges; i++)
+    {
+        offsets[edges.src[i] + 1]++;
+    }
+    for (size_t v = 0; v < num_names; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    vector<size_t> order(num_edges);
+    {
+        vector<size_t> pos(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < num_edges; i++)
+        {
+            order[pos[edges.src[i]]++] = i;
+        }
+    }
+
+    graph.vertices.reserve(num_names);
+    graph.adjacency_list.reserve(num_names);
+
+    vector<Vertex *> vs(num_names);
+    for (size_t v = 0; v < num_names; v++)
+    {
+        auto it = graph.vertices.emplace(edges.names[v], Vertex{edges.names[v], 0, 0}).first;
+        vs[v] = &it->second;
+    }
+    graph.num_vertices += num_names;
+
+    vector<size_t> bucket;
+    vector<pair<size_t, size_t>> runs;
+    for (size_t v = 0; v < num_names; v++)
+    {
+        vector<Edge<size_t>> &adj = graph.adjacency_list.emplace(*vs[v], vector<Edge<size_t>>()).first->second;
+
+        size_t b = offsets[v], e = offsets[v + 1];
+        if (b == e) { continue; }
+
+        // Sorted by (dest, position) duplicates are next to each other, the
+        // first of a run gives the place and the last one the weight.
+        bucket.assign(order.begin() + b, order.begin() + e);
+        std::sort(bucket.begin(), bucket.end(), [&edges](size_t x, size_t y) {
+            return edges.dest[x] != edges.dest[y] ? edges.dest[x] < edges.dest[y] : x < y;
+        });
+
+        runs.clear();
+        for (size_t i = 0; i < bucket.size();)
+        {
+            size_t j = i;
+            while (j + 1 < bucket.size() && edges.dest[bucket[j + 1]] == edges.dest[bucket[i]]) { j++; }
+            runs.emplace_back(bucket[i], bucket[j]);
+            i = j + 1;
+        }
+        std::sort(runs.begin(), runs.end());
+
+        adj.reserve(runs.size());
+        for (auto &run : runs)
+        {
+            Vertex &dest = *vs[edges.dest[run.first]];
+            adj.emplace_back(Edge<size_t>{*vs[v], dest, edges.weight[run.second]});
+            vs[v]->out_degree++;
+            dest.in_degree++;
+        }
+        graph.num_edges += runs.size();
+    }
+}
+
+/**
+ * Read graph from file.
+ * The format of graph should be:
+ * Vertex Vertex Weight
+ * the frist Vertex denote the source and the second is the destination.
+ * Weight should be a interger more than 0.
+ * A binary cache next to the file is used instead when it was made from
+ * a file of the same size and modification time.
+ */
+void build_graph(Graph<size_t> &graph, const string &file_path, int threads)
+{
+    EDGE_LIST edges;
+    string cache_path = edge_list_cache_path(file_path);
+
+    if (!load_edge_list_cache(cache_path, file_path, edges))
+    {
+        if (!parse_edge_list(file_path, edges, threads))
+        {
+            std::cout << "Read graph file failed!\n";
+            return;
+        }
+    }
+
+    build_graph(graph, edges);
 }
 
 /**
@@ -73,34 +499,39 @@ typename vector<Edge<T>>::iterator Graph<T>::find_edge(const Vertex &src, const
 template <class T>
 void Graph<T>::add_edge(string &src, string &dest, T &weight)
 {
-    if (this->vertices.find(src) == this->vertices.end())
+    auto it_src = this->vertices.find(src);
+    if (it_src == this->vertices.end())
     {
-        Vertex v_src{src, 0, 0};
-        this->vertices[src] = v_src;
+        it_src = this->vertices.emplace(src, Vertex{src, 0, 0}).first;
         this->num_vertices++;
-        this->adjacency_list[v_src] = vector<Edge<T>>();
+        this->adjacency_list.emplace(it_src->second, vector<Edge<T>>());
     }
 
-    if (this->vertices.find(dest) == this->vertices.end())
+    auto it_dest = this->vertices.find(dest);
+    if (it_dest == this->vertices.end())
     {
-        Vertex v_dest{dest, 0, 0};
-        this->vertices[dest] = v_dest;
+        it_dest = this->vertices.emplace(dest, Vertex{dest, 0, 0}).first;
         this->num_vertices++;
-        this->adjacency_list[v_dest] = vector<Edge<T>>();
+        this->adjacency_list.emplace(it_dest->second, vector<Edge<T>>());
     }
 
-    auto tmp = this->find_edge(this->vertices[src], this->vertices[dest]);
-    if (tmp != this->adjacency_list[this->vertices[src]].end())
-    {
-        tmp->weight = weight;
-    }
-    else
+    Vertex &v_src = it_src->second;
+    Vertex &v_dest = it_dest->second;
+
+    vector<Edge<T>> &adj = this->adjacency_list.at(v_src);
+    for (auto &e : adj)
     {
-        this->adjacency_list.at(this->vertices[src]).emplace_back(Edge<T>{this->vertices[src], this->vertices[dest], weight});
-        this->vertices[src].out_degree++;
-        this->vertices[dest].in_degree++;
-        this->num_edges++;
+        if (e.dest == v_dest)
+        {
+            e.weight = weight;
+            return;
+        }
     }
+
+    adj.emplace_back(Edge<T>{v_src, v_dest, weight});
+    v_src.out_degree++;
+    v_dest.in_degree++;
+    this->num_edges++;
 }
 
 /**
@@ -122,6 +553,263 @@ void Graph<T>::clear()
     this->num_edges = this->num_vertices = 0;
 }
 
+template <class T>
+CSRGraph<T>::CSRGraph() : names(), ids(), offsets(1, 0), targets(), weights(),
+                          rev_offsets(), rev_sources(), rev_edges(), pair()
+{
+}
+
+/**
+ * Give a name a dense id, the same name always gets the same one.
+ * Vertices have to be interned before the edges are assigned.
+*/
+template <class T>
+uint32_t CSRGraph<T>::intern(const string &name)
+{
+    auto result = this->ids.emplace(name, (uint32_t)this->names.size());
+    if (result.second)
+    {
+        this->names.push_back(name);
+    }
+    return result.first->second;
+}
+
+template <class T>
+uint32_t CSRGraph<T>::id_of(const string &name) const
+{
+    auto it = this->ids.find(name);
+    return it == this->ids.end() ? CSR_NO_VERTEX : it->second;
+}
+
+template <class T>
+size_t CSRGraph<T>::find_edge(uint32_t src, uint32_t dest) const
+{
+    for (size_t e = this->offsets[src]; e < this->offsets[src + 1]; e++)
+    {
+        if (this->targets[e] == dest)
+        {
+            return e;
+        }
+    }
+    return this->num_edges();
+}
+
+/**
+ * Lay out edges given by the ids of their ends.
+ * Out edges of a vertex keep the order they come in and duplicates are
+ * kept. The weights are moved out of weight.
+*/
+template <class T>
+void CSRGraph<T>::assign(const vector<uint32_t> &src, const vector<uint32_t> &dest, vector<T> &weight)
+{
+    size_t n = this->names.size();
+    size_t m = src.size();
+
+    this->offsets.assign(n + 1, 0);
+    for (size_t i = 0; i < m; i++)
+    {
+        this->offsets[src[i] + 1]++;
+    }
+    for (size_t v = 0; v < n; v++)
+    {
+        this->offsets[v + 1] += this->offsets[v];
+    }
+
+    this->targets.resize(m);
+    this->weights.clear();
+    this->weights.resize(m);
+
+    vector<size_t> pos(this->offsets.begin(), this->offsets.end() - 1);
+    for (size_t i = 0; i < m; i++)
+    {
+        size_t at = pos[src[i]]++;
+        this->targets[at] = dest[i];
+        std::swap(this->weights[at], weight[i]);
+    }
+
+    this->rev_offsets.clear();
+    this->rev_sources.clear();
+    this->rev_edges.clear();
+    this->pair.clear();
+}
+
+template <class T>
+void CSRGraph<T>::assign(const Graph<T> &graph)
+{
+    this->clear();
+    for (auto &v : graph.vertices)
+    {
+        this->intern(v.first);
+    }
+
+    vector<uint32_t> src, dest;
+    vector<T> weight;
+    src.reserve(graph.num_edges);
+    dest.reserve(graph.num_edges);
+    weight.reserve(graph.num_edges);
+
+    for (auto &v : graph.vertices)
+    {
+        uint32_t u = this->ids.at(v.first);
+        for (auto &e : graph.adjacency_list.at(v.second))
+        {
+            src.push_back(u);
+            dest.push_back(this->ids.at(e.dest.name));
+            weight.push_back(e.weight);
+        }
+    }
+
+    this->assign(src, dest, weight);
+}
+
+/**
+ * Build the in edges of every vertex. They are indexes of forward edges in
+ * the order of their sources.
+*/
+template <class T>
+void CSRGraph<T>::build_reverse()
+{
+    size_t n = this->num_vertices();
+    size_t m = this->num_edges();
+
+    this->rev_offsets.assign(n + 1, 0);
+    for (size_t e = 0; e < m; e++)
+    {
+        this->rev_offsets[this->targets[e] + 1]++;
+    }
+    for (size_t v = 0; v < n; v++)
+    {
+        this->rev_offsets[v + 1] += this->rev_offsets[v];
+    }
+
+    this->rev_sources.resize(m);
+    this->rev_edges.resize(m);
+
+    vector<size_t> pos(this->rev_offsets.begin(), this->rev_offsets.end() - 1);
+    for (uint32_t u = 0; u < n; u++)
+    {
+        for (size_t e = this->offsets[u]; e < this->offsets[u + 1]; e++)
+        {
+            size_t at = pos[this->targets[e]]++;
+            this->rev_sources[at] = u;
+            this->rev_edges[at] = e;
+        }
+    }
+}
+
+/**
+ * back[e] gets the first edge going back along e, the one find_edge would
+ * give, or num_edges() when there is none. One pass over the in edges of
+ * every vertex, with the first out edge to each neighbour kept in first.
+*/
+template <class T>
+static void find_back_edges(CSRGraph<T> &graph, vector<size_t> &back)
+{
+    size_t n = graph.num_vertices();
+    size_t m = graph.num_edges();
+
+    graph.build_reverse();
+    back.assign(m, m);
+    vector<size_t> first(n, m);
+    for (uint32_t v = 0; v < n; v++)
+    {
+        for (size_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++)
+        {
+            if (first[graph.targets[e]] == m) { first[graph.targets[e]] = e; }
+        }
+        for (size_t r = graph.rev_offsets[v]; r < graph.rev_offsets[v + 1]; r++)
+        {
+            back[graph.rev_edges[r]] = first[graph.rev_sources[r]];
+        }
+        for (size_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++)
+        {
+            first[graph.targets[e]] = m;
+        }
+    }
+
+    graph.rev_offsets.clear();
+    graph.rev_sources.clear();
+    graph.rev_edges.clear();
+}
+
+/**
+ * Turn the graph into a residual graph. Every edge without a reverse one
+ * gets a reverse edge weighted zero, and pair links each edge with the one
+ * going back. Returns which edges were added, they come after the original
+ * out edges of their source.
+*/
+template <class T>
+vector<char> CSRGraph<T>::build_residual(const T &zero)
+{
+    size_t n = this->num_vertices();
+    size_t m = this->num_edges();
+
+    vector<uint32_t> src, dest;
+    vector<T> weight;
+    src.reserve(2 * m);
+    dest.reserve(2 * m);
+    weight.reserve(2 * m);
+
+    vector<size_t> back;
+    find_back_edges(*this, back);
+
+    vector<size_t> degree(n);
+    for (uint32_t u = 0; u < n; u++)
+    {
+        degree[u] = this->out_degree(u);
+        for (size_t e = this->offsets[u]; e < this->offsets[u + 1]; e++)
+        {
+            src.push_back(u);
+            dest.push_back(this->targets[e]);
+            weight.push_back(this->weights[e]);
+        }
+    }
+    for (uint32_t u = 0; u < n; u++)
+    {
+        for (size_t e = this->offsets[u]; e < this->offsets[u + 1]; e++)
+        {
+            if (back[e] == m)
+            {
+                src.push_back(this->targets[e]);
+                dest.push_back(u);
+                weight.push_back(zero);
+            }
+        }
+    }
+
+    this->assign(src, dest, weight);
+
+    m = this->num_edges();
+    vector<char> added(m, 0);
+    for (uint32_t u = 0; u < n; u++)
+    {
+        for (size_t e = this->offsets[u]; e < this->offsets[u + 1]; e++)
+        {
+            added[e] = (e - this->offsets[u]) >= degree[u];
+        }
+    }
+    // assign cleared pair, it is set last.
+    find_back_edges(*this, back);
+    this->pair.swap(back);
+    return added;
+}
+
+template <class T>
+void CSRGraph<T>::clear()
+{
+    this->names.clear();
+    this->ids.clear();
+    this->offsets.assign(1, 0);
+    this->targets.clear();
+    this->weights.clear();
+    this->rev_offsets.clear();
+    this->rev_sources.clear();
+    this->rev_edges.clear();
+    this->pair.clear();
+}
+
 template class Graph<size_t>;
+template class CSRGraph<size_t>;
 #include <gmpxx.h>
-template class Graph<mpz_class>;
\ No newline at end of file
+template class Graph<mpz_class>;
+template class CSRGraph<mpz_class>;
\ No newline at end of file
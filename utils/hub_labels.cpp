@@ -0,0 +1,139 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include "hub_labels.hpp"
+
+using namespace std;
+
+namespace
+{
+    typedef pair<size_t, uint32_t> QUEUE_ITEM;
+
+    /**
+     * Dijkstra from the vertex of rank root, forward along out edges or
+     * backward along in edges. A vertex the labels already cover at the
+     * same distance is pruned, otherwise it gets root in its label.
+     * root_dist and dist are scratch arrays, left as they were found.
+    */
+    void pruned_dijkstra(const CSRGraph<size_t> &graph, HUB_LABELS &labels, uint32_t root, bool forward,
+                         vector<size_t> &root_dist, vector<size_t> &dist)
+    {
+        uint32_t r = labels.order[root];
+        const vector<HUB_LABEL> &root_label = forward ? labels.out[r] : labels.in[r];
+        for (auto &l : root_label)
+        {
+            root_dist[l.hub] = l.dist;
+        }
+
+        vector<uint32_t> visited;
+        priority_queue<QUEUE_ITEM, vector<QUEUE_ITEM>, greater<QUEUE_ITEM>> q;
+        dist[r] = 0;
+        visited.push_back(r);
+        q.push(QUEUE_ITEM(0, r));
+        while (!q.empty())
+        {
+            size_t d = q.top().first;
+            uint32_t u = q.top().second;
+            q.pop();
+            if (d > dist[u])
+            {
+                continue;
+            }
+
+            // Distance through a hub of higher rank.
+            vector<HUB_LABEL> &label = forward ? labels.in[u] : labels.out[u];
+            bool covered = false;
+            for (auto &l : label)
+            {
+                if (root_dist[l.hub] != HUB_NO_PATH && root_dist[l.hub] + l.dist <= d)
+                {
+                    covered = true;
+                    break;
+                }
+            }
+            if (covered)
+            {
+                continue;
+            }
+            label.push_back(HUB_LABEL{root, d});
+
+            size_t begin = forward ? graph.offsets[u] : graph.rev_offsets[u];
+            size_t end = forward ? graph.offsets[u + 1] : graph.rev_offsets[u + 1];
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t v = forward ? graph.targets[i] : graph.rev_sources[i];
+                size_t w = forward ? graph.weights[i] : graph.weights[graph.rev_edges[i]];
+                if (d + w < dist[v])
+                {
+                    if (dist[v] == HUB_NO_PATH) { visited.push_back(v); }
+                    dist[v] = d + w;
+                    q.push(QUEUE_ITEM(d + w, v));
+                }
+            }
+        }
+
+        for (auto v : visited)
+        {
+            dist[v] = HUB_NO_PATH;
+        }
+        for (auto &l : root_label)
+        {
+            root_dist[l.hub] = HUB_NO_PATH;
+        }
+    }
+} // namespace
+
+bool build_hub_labels(const CSRGraph<size_t> &graph, HUB_LABELS &labels)
+{
+    size_t n = graph.num_vertices();
+    if (graph.rev_offsets.size() != n + 1)
+    {
+        cerr << "Hub labels need the reverse CSR of the graph!" << endl;
+        return false;
+    }
+
+    // Vertices of high degree first, they cover the most shortest paths.
+    labels.order.resize(n);
+    for (uint32_t v = 0; v < n; v++)
+    {
+        labels.order[v] = v;
+    }
+    stable_sort(labels.order.begin(), labels.order.end(), [&graph](uint32_t x, uint32_t y) {
+        return graph.out_degree(x) + graph.in_degree(x) > graph.out_degree(y) + graph.in_degree(y);
+    });
+
+    labels.out.assign(n, vector<HUB_LABEL>());
+    labels.in.assign(n, vector<HUB_LABEL>());
+
+    vector<size_t> root_dist(n, HUB_NO_PATH), dist(n, HUB_NO_PATH);
+    for (uint32_t root = 0; root < n; root++)
+    {
+        pruned_dijkstra(graph, labels, root, true, root_dist, dist);
+        pruned_dijkstra(graph, labels, root, false, root_dist, dist);
+    }
+    return true;
+}
+
+size_t hub_distance(const HUB_LABELS &labels, uint32_t s, uint32_t t)
+{
+    const vector<HUB_LABEL> &out = labels.out[s];
+    const vector<HUB_LABEL> &in = labels.in[t];
+
+    size_t best = HUB_NO_PATH;
+    size_t i = 0, j = 0;
+    while (i < out.size() && j < in.size())
+    {
+        if (out[i].hub < in[j].hub) { i++; }
+        else if (out[i].hub > in[j].hub) { j++; }
+        else
+        {
+            best = min(best, out[i].dist + in[j].dist);
+            i++;
+            j++;
+        }
+    }
+    return best;
+}
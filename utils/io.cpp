@@ -122,6 +122,7 @@ bool load_sk(const fs::path& p, SK& sk)
     sk.k_1 = hex_to_raw(j["k_1"].get<string>());
     sk.k_2 = hex_to_raw(j["k_2"].get<string>());
     sk.k_3 = hex_to_raw(j["k_3"].get<string>());
+    sk_expand(sk);
     
     is.close();
     return true;
@@ -267,3 +268,126 @@ bool load_De(const string& file_path, unordered_map<string, string>& D_e)
 {
     return load_De(fs::path(file_path), D_e);
 }
+
+fs::path de_shard_path(const fs::path& dir, int idx)
+{
+    return dir / ("de." + to_string(idx) + ".bin");
+}
+
+static fs::path de_count_path(const fs::path& dir)
+{
+    return dir / "de.count";
+}
+
+bool save_De_shard_count(const fs::path& dir, int count)
+{
+    ofstream os(de_count_path(dir).string(), ofstream::out | ofstream::trunc);
+    os << count << endl;
+    return !os.fail();
+}
+
+int load_De_shard_count(const fs::path& dir)
+{
+    ifstream is(de_count_path(dir).string());
+    int count = -1;
+    if (!(is >> count)) { return -1; }
+    return count;
+}
+
+bool append_De_shard(const fs::path& dir, const unordered_map<string, string>& D_e)
+{
+    int count = load_De_shard_count(dir);
+    if (count < 0) { count = 0; }
+    if (!save_De(de_shard_path(dir, count), D_e)) { return false; }
+    return save_De_shard_count(dir, count + 1);
+}
+
+bool load_De_shards(const fs::path& dir, unordered_map<string, string>& D_e)
+{
+    int count = load_De_shard_count(dir);
+    if (count >= 0)
+    {
+        for (int idx = 0; idx < count; idx++)
+        {
+            if (!load_De(de_shard_path(dir, idx), D_e)) { return false; }
+        }
+        return count > 0;
+    }
+
+    // Older outdirs have no count, read up to the first missing shard.
+    int idx = 0;
+    while (fs::exists(de_shard_path(dir, idx)))
+    {
+        if (!load_De(de_shard_path(dir, idx), D_e)) { return false; }
+        idx++;
+    }
+    return idx > 0;
+}
+
+bool load_De_shards(const string& dir_path, unordered_map<string, string>& D_e)
+{
+    return load_De_shards(fs::path(dir_path), D_e);
+}
+
+DeShardWriter::DeShardWriter(const fs::path& dir, int shard_num)
+    : dir(dir), shards(), counts(shard_num, 0)
+{
+    if (!fs::exists(dir))
+    {
+        fs::create_directories(dir);
+    }
+    size_t size = 0;
+    for (int i = 0; i < shard_num; i ++)
+    {
+        this->shards.emplace_back(de_shard_path(dir, i).string(), ofstream::out | ofstream::binary);
+        // Placeholder, patched in close()
+        this->shards.back().write(reinterpret_cast<char*>(&size), sizeof(size_t));
+    }
+}
+
+DeShardWriter::~DeShardWriter()
+{
+    this->close();
+}
+
+void DeShardWriter::append(const string& key, const string& value)
+{
+    size_t idx = std::hash<string>()(key) % this->shards.size();
+    ofstream& os = this->shards[idx];
+
+    size_t bytes_num = key.size();
+    os.write(reinterpret_cast<char*>(&bytes_num), sizeof(size_t));
+    os.write(key.c_str(), bytes_num);
+
+    bytes_num = value.size();
+    os.write(reinterpret_cast<char*>(&bytes_num), sizeof(size_t));
+    os.write(value.c_str(), bytes_num);
+
+    this->counts[idx]++;
+}
+
+void DeShardWriter::append(const unordered_map<string, string>& D_e)
+{
+    for (auto it = D_e.begin(); it != D_e.end(); it++)
+    {
+        this->append(it->first, it->second);
+    }
+}
+
+void DeShardWriter::close()
+{
+    bool closed = false;
+    for (size_t i = 0; i < this->shards.size(); i ++)
+    {
+        ofstream& os = this->shards[i];
+        if (!os.is_open()) { continue; }
+        os.seekp(0, os.beg);
+        os.write(reinterpret_cast<char*>(&this->counts[i]), sizeof(size_t));
+        os.close();
+        closed = true;
+    }
+    if (closed)
+    {
+        save_De_shard_count(this->dir, (int)this->shards.size());
+    }
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include "landmarks.hpp"
+
+using namespace std;
+
+namespace
+{
+    typedef pair<size_t, uint32_t> QUEUE_ITEM;
+
+    /**
+     * Plain Dijkstra from root into dist, along out edges or, backward,
+     * along in edges.
+    */
+    void dijkstra(const CSRGraph<size_t> &graph, uint32_t root, bool forward, vector<size_t> &dist)
+    {
+        dist.assign(graph.num_vertices(), LANDMARK_NO_PATH);
+        priority_queue<QUEUE_ITEM, vector<QUEUE_ITEM>, greater<QUEUE_ITEM>> q;
+        dist[root] = 0;
+        q.push(QUEUE_ITEM(0, root));
+        while (!q.empty())
+        {
+            size_t d = q.top().first;
+            uint32_t u = q.top().second;
+            q.pop();
+            if (d > dist[u])
+            {
+                continue;
+            }
+
+            size_t begin = forward ? graph.offsets[u] : graph.rev_offsets[u];
+            size_t end = forward ? graph.offsets[u + 1] : graph.rev_offsets[u + 1];
+            for (size_t i = begin; i < end; i++)
+            {
+                uint32_t v = forward ? graph.targets[i] : graph.rev_sources[i];
+                size_t w = forward ? graph.weights[i] : graph.weights[graph.rev_edges[i]];
+                if (d + w < dist[v])
+                {
+                    dist[v] = d + w;
+                    q.push(QUEUE_ITEM(d + w, v));
+                }
+            }
+        }
+    }
+} // namespace
+
+bool select_landmarks(const CSRGraph<size_t> &graph, size_t num, LANDMARKS &landmarks)
+{
+    size_t n = graph.num_vertices();
+    if (graph.rev_offsets.size() != n + 1)
+    {
+        cerr << "Landmarks need the reverse CSR of the graph!" << endl;
+        return false;
+    }
+
+    landmarks.vertices.clear();
+    landmarks.from.clear();
+    landmarks.to.clear();
+    if (n == 0)
+    {
+        return true;
+    }
+    num = min(num, n);
+
+    // The first one is the vertex of highest degree, each next one is the
+    // vertex farthest from those picked so far. Vertices no landmark reaches
+    // count as farthest, they are in a part of the graph not covered yet.
+    uint32_t next = 0;
+    for (uint32_t v = 1; v < n; v++)
+    {
+        if (graph.out_degree(v) + graph.in_degree(v) > graph.out_degree(next) + graph.in_degree(next))
+        {
+            next = v;
+        }
+    }
+
+    vector<size_t> nearest(n, LANDMARK_NO_PATH);
+    vector<char> picked(n, 0);
+    while (landmarks.vertices.size() < num)
+    {
+        landmarks.vertices.push_back(next);
+        picked[next] = 1;
+        landmarks.from.emplace_back();
+        landmarks.to.emplace_back();
+        dijkstra(graph, next, true, landmarks.from.back());
+        dijkstra(graph, next, false, landmarks.to.back());
+
+        const vector<size_t> &from = landmarks.from.back();
+        bool found = false;
+        for (uint32_t v = 0; v < n; v++)
+        {
+            nearest[v] = min(nearest[v], from[v]);
+            if (!picked[v] && (!found || nearest[v] > nearest[next]))
+            {
+                next = v;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+size_t landmark_cap(const LANDMARKS &landmarks)
+{
+    size_t cap = 0;
+    for (size_t j = 0; j < landmarks.vertices.size(); j++)
+    {
+        for (size_t v = 0; v < landmarks.from[j].size(); v++)
+        {
+            if (landmarks.from[j][v] != LANDMARK_NO_PATH) { cap = max(cap, landmarks.from[j][v]); }
+            if (landmarks.to[j][v] != LANDMARK_NO_PATH) { cap = max(cap, landmarks.to[j][v]); }
+        }
+    }
+    return cap;
+}
@@ -0,0 +1,130 @@
+#include <utility>
+
+#include "mask_pool.hpp"
+
+using namespace std;
+
+MaskPool::MaskPool(GENERATOR gen, size_t depth, const vector<int> &bits, int threads)
+    : gen(gen), depth(depth), queues(), workers(), stop(false), num_hits(0), num_misses(0)
+{
+    for (int b : bits)
+    {
+        this->queues[b].pending = 0;
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        this->workers.emplace_back(&MaskPool::worker_loop, this);
+    }
+}
+
+MaskPool::~MaskPool()
+{
+    {
+        unique_lock<mutex> lck(this->mtx);
+        this->stop = true;
+    }
+    this->want.notify_all();
+    this->filled.notify_all();
+    for (auto &w : this->workers)
+    {
+        w.join();
+    }
+}
+
+bool MaskPool::lowest(int &bits) const
+{
+    size_t least = this->depth;
+    for (auto &q : this->queues)
+    {
+        size_t have = q.second.ready.size() + q.second.pending;
+        if (have < least)
+        {
+            least = have;
+            bits = q.first;
+        }
+    }
+    return least < this->depth;
+}
+
+bool MaskPool::all_full() const
+{
+    for (auto &q : this->queues)
+    {
+        if (q.second.ready.size() < this->depth) { return false; }
+    }
+    return true;
+}
+
+void MaskPool::worker_loop()
+{
+    int bits = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lck(this->mtx);
+            this->want.wait(lck, [this, &bits] { return this->stop || this->lowest(bits); });
+            if (this->stop) { return; }
+            this->queues[bits].pending++;
+        }
+
+        // The expensive part runs unlocked, takes go on meanwhile.
+        mpz_class mask, enc;
+        this->gen(bits, mask, enc);
+
+        {
+            unique_lock<mutex> lck(this->mtx);
+            QUEUE &q = this->queues[bits];
+            q.pending--;
+            q.ready.emplace_back(move(mask), move(enc));
+            if (this->all_full()) { this->filled.notify_all(); }
+        }
+    }
+}
+
+void MaskPool::take(int bits, mpz_class &mask, mpz_class &enc)
+{
+    {
+        unique_lock<mutex> lck(this->mtx);
+        QUEUE &q = this->queues[bits];
+        if (!q.ready.empty())
+        {
+            mask = move(q.ready.front().first);
+            enc = move(q.ready.front().second);
+            q.ready.pop_front();
+            this->num_hits++;
+            lck.unlock();
+            this->want.notify_one();
+            return;
+        }
+        this->num_misses++;
+    }
+    // A new size has its queue now, the workers start on it.
+    this->want.notify_one();
+    this->gen(bits, mask, enc);
+}
+
+void MaskPool::wait_full()
+{
+    unique_lock<mutex> lck(this->mtx);
+    if (this->workers.empty()) { return; }
+    this->filled.wait(lck, [this] { return this->stop || this->all_full(); });
+}
+
+size_t MaskPool::ready(int bits) const
+{
+    unique_lock<mutex> lck(this->mtx);
+    auto it = this->queues.find(bits);
+    return it == this->queues.end() ? 0 : it->second.ready.size();
+}
+
+size_t MaskPool::hits() const
+{
+    unique_lock<mutex> lck(this->mtx);
+    return this->num_hits;
+}
+
+size_t MaskPool::misses() const
+{
+    unique_lock<mutex> lck(this->mtx);
+    return this->num_misses;
+}
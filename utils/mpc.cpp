@@ -64,7 +64,127 @@ void gen_random(mpz_class &r_left, mpz_class &r_right, int size)
     gen_random_single(r_right, size);
 }
 
-void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, tcp::socket& sock)
+// Masks made ahead of time, see use_mask_pool.
+static MaskPool* g_mask_pool = nullptr;
+
+MaskPool::GENERATOR mask_generator(const JL_PK& jl_pk)
+{
+    JL_PK pk = jl_pk;
+    return [pk](int bits, mpz_class& mask, mpz_class& enc) mutable {
+        gen_random_single(mask, bits);
+        JL_encryption(pk, mask, enc);
+    };
+}
+
+void use_mask_pool(MaskPool* pool)
+{
+    g_mask_pool = pool;
+}
+
+void blinding_mask(JL_PK& jl_pk, int bits, mpz_class& mask, mpz_class& enc)
+{
+    if (g_mask_pool != nullptr)
+    {
+        g_mask_pool->take(bits, mask, enc);
+        return;
+    }
+    gen_random_single(mask, bits);
+    JL_encryption(jl_pk, mask, enc);
+}
+
+int compare_circuit(int mode)
+{
+    switch (mode)
+    {
+        case COMPARE_HIGHER: return SEC_GDB_COMPARE_GT;
+        case COMPARE_LOWER: return SEC_GDB_COMPARE_LT;
+        case COMPARE_EQUAL: return SEC_GDB_COMPARE_EQ;
+        default: throw sec_gdb_global_exception("Unknown compare mode!");
+    }
+}
+
+int width_bits(int width)
+{
+    switch (width)
+    {
+        case SEC_GDB_WIDTH_16: return 16;
+        case SEC_GDB_WIDTH_32: return 32;
+        case SEC_GDB_WIDTH_64: return 64;
+        default: throw sec_gdb_global_exception("Unknown compare width!");
+    }
+}
+
+int compare_width(const mpz_class& bound)
+{
+    // A value and its mask each stay below 2^(bits - 2), so the masked
+    // value is positive and neither the sum nor the unmasking overflows.
+    mpz_class abs_bound = abs(bound);
+    for (int width : {SEC_GDB_WIDTH_16, SEC_GDB_WIDTH_32, SEC_GDB_WIDTH_64})
+    {
+        if (abs_bound < (mpz_class(1) << (width_bits(width) - 2)))
+        {
+            return width;
+        }
+    }
+    throw sec_gdb_global_exception("No compare circuit is wide enough for the bound!");
+}
+
+int compare_slots(int width)
+{
+    return MAX_COMPARE_BATCH * 32 / width_bits(width);
+}
+
+namespace
+{
+    typedef void (*OBLIVC_CIRCUIT)(void*);
+
+    // By width and then by circuit, in the order of SEC_GDB_WIDTH_* and
+    // SEC_GDB_COMPARE_*.
+    const OBLIVC_CIRCUIT compare_circuits[3][4] = {
+        {compare, compare_gt, compare_lt, compare_eq},
+        {compare16, compare_gt16, compare_lt16, compare_eq16},
+        {compare64, compare_gt64, compare_lt64, compare_eq64},
+    };
+
+    OBLIVC_CIRCUIT circuit_of(int circuit, int width)
+    {
+        if (circuit < 0 || circuit > SEC_GDB_COMPARE_EQ || width < 0 || width > SEC_GDB_WIDTH_64)
+        {
+            throw sec_gdb_global_exception("Unknown compare circuit!");
+        }
+        return compare_circuits[width][circuit];
+    }
+
+    // select_min and sign_test by width.
+    const OBLIVC_CIRCUIT min_circuits[3] = {select_min, select_min16, select_min64};
+    const OBLIVC_CIRCUIT sign_circuits[3] = {sign_test, sign_test16, sign_test64};
+
+    OBLIVC_CIRCUIT width_circuit(const OBLIVC_CIRCUIT circuits[3], int width)
+    {
+        if (width < 0 || width > SEC_GDB_WIDTH_64)
+        {
+            throw sec_gdb_global_exception("Unknown compare width!");
+        }
+        return circuits[width];
+    }
+
+    // What circuit reveals for left and right in plain.
+    int plain_compare(const mpz_class& left, const mpz_class& right, int circuit)
+    {
+        switch (circuit)
+        {
+            case SEC_GDB_COMPARE_GT: return left > right ? 1 : 0;
+            case SEC_GDB_COMPARE_LT: return left < right ? 1 : 0;
+            case SEC_GDB_COMPARE_EQ: return left == right ? 1 : 0;
+            default:
+                if (left > right) { return COMPARE_HIGHER; }
+                else if (left == right) { return COMPARE_EQUAL; }
+                else { return COMPARE_LOWER; }
+        }
+    }
+} // namespace
+
+void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, tcp::socket& sock, int circuit, int width)
 {
     mpz_class left, right, unblinded_left, unblinded_right;
     net_recv_mpz_class(sock, left);
@@ -86,7 +206,7 @@ void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, tcp::socket&
     ProtocolDesc ppd = {0};
     protocolUseTcp2PKeepAlive(&ppd, sock.native_handle(), false);
     setCurrentParty(&ppd, SEC_GDB_OBLIVC_PROXY);
-    execYaoProtocol(&ppd, compare, &io);
+    execYaoProtocol(&ppd, circuit_of(circuit, width), &io);
     cleanupProtocol(&ppd);
 
 #ifdef SEC_GDB_DBG
@@ -94,15 +214,13 @@ void secure_compare_remote(ProtocolDesc& pd, JL_PK& pk, JL_SK& sk, tcp::socket&
 #endif // SEC_GDB_DBG
 }
 
-int secure_compare(ProtocolDesc& pd, JL_PK& jl_pk, mpz_class& left, mpz_class& right, tcp::socket& sock)
+int secure_compare(ProtocolDesc& pd, JL_PK& jl_pk, mpz_class& left, mpz_class& right, tcp::socket& sock, int circuit, int width)
 {
     g_compare_counter ++;
     int result = 0;
     auto start_time = std::chrono::high_resolution_clock::now();
 #ifdef SEC_GDB_WITHOUT_ENCRYPTION
-    if (left > right) { result  = COMPARE_HIGHER; }
-    else if (left == right) { result = COMPARE_EQUAL; }
-    else { result = COMPARE_LOWER; }
+    result = plain_compare(left, right, circuit);
 #else //SEC_GDB_WITHOUT_ENCRYPTION
     mpz_class r_left, r_right, r_left_enc, r_right_enc;
 
@@ -114,10 +232,8 @@ int secure_compare(ProtocolDesc& pd, JL_PK& jl_pk, mpz_class& left, mpz_class& r
 #endif
 
     // Subtracting 2 is for preventing overflow
-    gen_random(r_left, r_right, sizeof(OBLIVC_DATA_TYPE) * 8  - 2);
-
-    JL_encryption(jl_pk, r_left, r_left_enc);
-    JL_encryption(jl_pk, r_right, r_right_enc);
+    blinding_mask(jl_pk, width_bits(width) - 2, r_left, r_left_enc);
+    blinding_mask(jl_pk, width_bits(width) - 2, r_right, r_right_enc);
     
     mpz_class blinded_left = JL_homo_add(jl_pk, left, r_left_enc);
     mpz_class blinded_right = JL_homo_add(jl_pk, right, r_right_enc);
@@ -139,7 +255,7 @@ int secure_compare(ProtocolDesc& pd, JL_PK& jl_pk, mpz_class& left, mpz_class& r
     ProtocolDesc ppd = {0};
     protocolUseTcp2PKeepAlive(&ppd, sock.native_handle(), true);
     setCurrentParty(&ppd, SEC_GDB_OBLIVC_SERVER);
-    execYaoProtocol(&ppd, compare, &io);
+    execYaoProtocol(&ppd, circuit_of(circuit, width), &io);
     cleanupProtocol(&ppd);
 
     result = io.result;
@@ -153,12 +269,13 @@ int secure_compare(ProtocolDesc& pd, JL_PK& jl_pk, mpz_class& left, mpz_class& r
     return result;
 }
 
-void secure_compare_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock)
+void secure_compare_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock, int circuit, int width)
 {
     // Assume two element batch
     int bn = 2;
 
-    mpz_class shifter(1L << (sizeof(OBLIVC_DATA_TYPE) * 8L));
+    const int bits = width_bits(width);
+    mpz_class shifter = mpz_class(1) << bits;
     mpz_class blinded_left, blinded_right, left, right;
 
     boost::system::error_code ec;
@@ -181,47 +298,54 @@ void secure_compare_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock)
         tmp_left = left % shifter;
         tmp_right = right % shifter;
 
-        left >>= (sizeof(OBLIVC_DATA_TYPE) * 8L);
-        right >>= (sizeof(OBLIVC_DATA_TYPE) * 8L);
+        left >>= bits;
+        right >>= bits;
 
-        io.a_1 = tmp_left.get_si();
-        io.a_2 = tmp_right.get_si();
+        io.a_1 = (OBLIVC_WIDE_TYPE)tmp_left.get_ui();
+        io.a_2 = (OBLIVC_WIDE_TYPE)tmp_right.get_ui();
         setCurrentParty(&pd, SEC_GDB_OBLIVC_PROXY);
-        execYaoProtocol(&pd, compare, &io);
+        execYaoProtocol(&pd, circuit_of(circuit, width), &io);
     }
     cleanupProtocol(&pd);
 }
 
-vector<int> secure_compare_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<mpz_class>& right, tcp::socket& sock)
+vector<int> secure_compare_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<mpz_class>& right, tcp::socket& sock, int circuit, int width)
 {
     // Start time 
     auto start_time = chrono::high_resolution_clock::now();
     
     // For num shifting
-    mpz_class shifter(1L << (sizeof(OBLIVC_DATA_TYPE) * 8L));
+    const int bits = width_bits(width);
+    mpz_class shifter = mpz_class(1) << bits;
 
-    // Assert elements number no more than 4
-    assert(left.size() == left.size());
-    assert(left.size() <= 4);
+    // Assert elements number no more than fit in one plaintext
+    assert(left.size() == right.size());
+    assert((int)left.size() <= compare_slots(width));
 
     int bn = left.size();
+    g_compare_counter += bn;
+    vector<int> rtn(bn);
 
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    for (int i = 0; i < bn; i ++)
+    {
+        rtn[i] = plain_compare(left[i], right[i], circuit);
+    }
+#else
     mpz_class zero(0),  blind_left, blind_right;
-    JL_encryption(jl_pk, zero, blind_left);
-    JL_encryption(jl_pk, zero, blind_right);
+    blinding_mask(jl_pk, 0, zero, blind_left);
+    blinding_mask(jl_pk, 0, zero, blind_right);
 
     vector<mpz_class> left_mask(bn), enc_left_mask(bn);
     vector<mpz_class> right_mask(bn), enc_right_mask(bn);
 
     for (int i = 0; i < bn; i ++)
     {
-        gen_random_single(left_mask[i], sizeof(OBLIVC_DATA_TYPE) * 8  - 2);
-        JL_encryption(jl_pk, left_mask[i], enc_left_mask[i]);
+        blinding_mask(jl_pk, bits - 2, left_mask[i], enc_left_mask[i]);
         blind_left = JL_homo_mul(jl_pk, blind_left, shifter);
         blind_left = JL_homo_add(jl_pk, blind_left, JL_homo_add(jl_pk, left[i], enc_left_mask[i]));
         
-        gen_random_single(right_mask[i], sizeof(OBLIVC_DATA_TYPE) * 8  - 2);
-        JL_encryption(jl_pk, right_mask[i], enc_right_mask[i]);
+        blinding_mask(jl_pk, bits - 2, right_mask[i], enc_right_mask[i]);
         blind_right = JL_homo_mul(jl_pk, blind_right, shifter);
         blind_right = JL_homo_add(jl_pk, blind_right, JL_homo_add(jl_pk, right[i], enc_right_mask[i]));
     }
@@ -234,8 +358,6 @@ vector<int> secure_compare_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<m
     auto comm_end = chrono::high_resolution_clock::now();
     g_cmp_comm_time += chrono::duration<double>(comm_end - comm_start).count();
 
-    vector<int> rtn(bn);
-
     ProtocolDesc pd = {0};
     protocolUseTcp2PKeepAlive(&pd, sock.native_handle(), true);
     for (int i = bn - 1; i >= 0; i --) // For the ease of remote
@@ -244,10 +366,11 @@ vector<int> secure_compare_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<m
         io.r_1 = left_mask[i].get_si();
         io.r_2 = right_mask[i].get_si();
         setCurrentParty(&pd, SEC_GDB_OBLIVC_SERVER);
-        execYaoProtocol(&pd, compare, &io);
+        execYaoProtocol(&pd, circuit_of(circuit, width), &io);
         rtn[i] = io.result;
     }
     cleanupProtocol(&pd);
+#endif //SEC_GDB_WITHOUT_ENCRYPTION
 
     // End time
     auto end_time = chrono::high_resolution_clock::now();
@@ -256,6 +379,288 @@ vector<int> secure_compare_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<m
     return rtn;
 }
 
+/**
+ * Points the arrays of a sign_test io of n values into buff.
+*/
+void sign_io_init(OBLIVC_SIGN_IO& io, vector<OBLIVC_WIDE_TYPE>& buff, vector<int>& result, int n)
+{
+    buff.assign(2 * n, 0);
+    result.assign(n, 0);
+    io.n = n;
+    io.a = buff.data();
+    io.r = io.a + n;
+    io.result = result.data();
+}
+
+void secure_sign_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock, int width)
+{
+    const int slot_bits = width_bits(width);
+    const int slots = compare_slots(width);
+    mpz_class shifter = mpz_class(1) << slot_bits;
+
+    int bn = 0;
+    boost::system::error_code ec;
+    boost::asio::read(sock, boost::asio::buffer(reinterpret_cast<char*>(&bn), sizeof(bn)), ec);
+    if (ec) { throw sec_gdb_network_exception("Receiving secure sign size failed!", ec.value()); }
+
+    OBLIVC_SIGN_IO io = {0};
+    vector<OBLIVC_WIDE_TYPE> buff;
+    vector<int> result;
+    sign_io_init(io, buff, result, bn);
+
+    // slots values a ciphertext, the first one in the highest slot.
+    mpz_class blinded, packed, slot;
+    for (int begin = 0; begin < bn; begin += slots)
+    {
+        int end = min(bn, begin + slots);
+        net_recv_mpz_class(sock, blinded);
+        JL_decryption(jl_sk, jl_pk, blinded, packed);
+        for (int i = end - 1; i >= begin; i --)
+        {
+            slot = packed % shifter;
+            packed >>= slot_bits;
+            io.a[i] = (OBLIVC_WIDE_TYPE)slot.get_ui();
+        }
+    }
+
+    ProtocolDesc pd = {0};
+    protocolUseTcp2PKeepAlive(&pd, sock.native_handle(), false);
+    setCurrentParty(&pd, SEC_GDB_OBLIVC_PROXY);
+    execYaoProtocol(&pd, width_circuit(sign_circuits, width), &io);
+    cleanupProtocol(&pd);
+}
+
+vector<int> secure_sign_batch(JL_PK& jl_pk, const vector<mpz_class>& values, tcp::socket& sock, int width)
+{
+    auto start_time = chrono::high_resolution_clock::now();
+
+    int bn = values.size();
+    g_sign_counter += bn;
+    vector<int> rtn(bn);
+
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    for (int i = 0; i < bn; i ++)
+    {
+        int s = sgn(values[i]);
+        rtn[i] = s > 0 ? COMPARE_HIGHER : (s == 0 ? COMPARE_EQUAL : COMPARE_LOWER);
+    }
+#else
+    const int slot_bits = width_bits(width);
+    const int slots = compare_slots(width);
+    mpz_class shifter = mpz_class(1) << slot_bits;
+
+    // A slot holds v + r + 2^(slot_bits - 1). With |v| and r below
+    // 2^(slot_bits - 2) it is positive and fits, so a negative v does not
+    // borrow from the slot above. The circuit takes the offset out again as
+    // part of the mask.
+    mpz_class offset = mpz_class(1) << (slot_bits - 1);
+
+    OBLIVC_SIGN_IO io = {0};
+    vector<OBLIVC_WIDE_TYPE> buff;
+    vector<int> result;
+    sign_io_init(io, buff, result, bn);
+
+    // The offset is the same for every slot, its encryption is shared and
+    // the fresh masks randomize the sums.
+    mpz_class enc_offset;
+    JL_encryption(jl_pk, offset, enc_offset);
+
+    vector<mpz_class> blinded((bn + slots - 1) / slots);
+    mpz_class zero(0), mask, enc_mask;
+    for (int begin = 0, k = 0; begin < bn; begin += slots, k ++)
+    {
+        int end = min(bn, begin + slots);
+        blinding_mask(jl_pk, 0, zero, blinded[k]);
+        for (int i = begin; i < end; i ++)
+        {
+            blinding_mask(jl_pk, slot_bits - 2, mask, enc_mask);
+            mask += offset;
+            enc_mask = JL_homo_add(jl_pk, enc_mask, enc_offset);
+            blinded[k] = JL_homo_mul(jl_pk, blinded[k], shifter);
+            blinded[k] = JL_homo_add(jl_pk, blinded[k], JL_homo_add(jl_pk, values[i], enc_mask));
+            io.r[i] = (OBLIVC_WIDE_TYPE)mask.get_ui();
+        }
+    }
+
+    auto comm_start = chrono::high_resolution_clock::now();
+    boost::system::error_code ec;
+    boost::asio::write(sock, boost::asio::buffer(reinterpret_cast<char*>(&bn), sizeof(bn)), ec);
+    if (ec) { throw sec_gdb_network_exception("Sending secure sign size failed!", ec.value()); }
+    for (auto& b : blinded)
+    {
+        net_send_mpz_class(sock, b);
+    }
+    auto comm_end = chrono::high_resolution_clock::now();
+    g_cmp_comm_time += chrono::duration<double>(comm_end - comm_start).count();
+
+    ProtocolDesc pd = {0};
+    protocolUseTcp2PKeepAlive(&pd, sock.native_handle(), true);
+    setCurrentParty(&pd, SEC_GDB_OBLIVC_SERVER);
+    execYaoProtocol(&pd, width_circuit(sign_circuits, width), &io);
+    cleanupProtocol(&pd);
+
+    for (int i = 0; i < bn; i ++)
+    {
+        rtn[i] = result[i] > 0 ? COMPARE_HIGHER : (result[i] == 0 ? COMPARE_EQUAL : COMPARE_LOWER);
+    }
+#endif //SEC_GDB_WITHOUT_ENCRYPTION
+
+    auto end_time = chrono::high_resolution_clock::now();
+    g_sign_time_cost += chrono::duration<double>(end_time - start_time).count();
+
+    return rtn;
+}
+
+
+/**
+ * Points the arrays of a select_min io of n pairs into buff.
+*/
+void min_io_init(OBLIVC_MIN_IO& io, vector<OBLIVC_WIDE_TYPE>& buff, vector<int>& bits, int n)
+{
+    buff.assign(6 * n, 0);
+    bits.assign(2 * n, 0);
+    io.n = n;
+    io.a_1 = buff.data();
+    io.a_2 = io.a_1 + n;
+    io.r_1 = io.a_2 + n;
+    io.r_2 = io.r_1 + n;
+    io.r_3 = io.r_2 + n;
+    io.min = io.r_3 + n;
+    io.s = bits.data();
+    io.sel = io.s + n;
+}
+
+void secure_min_batch_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock, int width)
+{
+    // Number of pairs and whether the selectors are wanted.
+    int head[2] = {0, 0};
+    boost::system::error_code ec;
+    boost::asio::read(sock, boost::asio::buffer(reinterpret_cast<char*>(head), sizeof(head)), ec);
+    if (ec) { throw sec_gdb_network_exception("Receiving secure min size failed!", ec.value()); }
+    int bn = head[0];
+
+    OBLIVC_MIN_IO io = {0};
+    vector<OBLIVC_WIDE_TYPE> buff;
+    vector<int> bits;
+    min_io_init(io, buff, bits, bn);
+
+    mpz_class blinded, plain;
+    for (int i = 0; i < bn; i ++)
+    {
+        net_recv_mpz_class(sock, blinded);
+        JL_decryption(jl_sk, jl_pk, blinded, plain);
+        io.a_1[i] = plain.get_si();
+        net_recv_mpz_class(sock, blinded);
+        JL_decryption(jl_sk, jl_pk, blinded, plain);
+        io.a_2[i] = plain.get_si();
+    }
+
+    ProtocolDesc pd = {0};
+    protocolUseTcp2PKeepAlive(&pd, sock.native_handle(), false);
+    setCurrentParty(&pd, SEC_GDB_OBLIVC_PROXY);
+    execYaoProtocol(&pd, width_circuit(min_circuits, width), &io);
+    cleanupProtocol(&pd);
+
+    // Fresh encryptions, the server can not link them to what it sent. The
+    // min is under r_3, both below 2^(bits - 2), so the sum stays positive.
+    mpz_class plain_min, plain_sel, enc;
+    for (int i = 0; i < bn; i ++)
+    {
+        plain_min = (long)io.min[i];
+        JL_encryption(jl_pk, plain_min, enc);
+        net_send_mpz_class(sock, enc);
+        if (head[1])
+        {
+            plain_sel = io.sel[i];
+            JL_encryption(jl_pk, plain_sel, enc);
+            net_send_mpz_class(sock, enc);
+        }
+    }
+}
+
+void secure_min_batch(JL_PK& jl_pk, vector<mpz_class>& left, vector<mpz_class>& right, tcp::socket& sock,
+                      vector<mpz_class>& min, vector<mpz_class>* selector, int width)
+{
+    auto start_time = chrono::high_resolution_clock::now();
+    assert(left.size() == right.size());
+
+    int bn = left.size();
+    g_min_counter += bn;
+    min.resize(bn);
+    if (selector != nullptr) { selector->resize(bn); }
+
+#ifdef SEC_GDB_WITHOUT_ENCRYPTION
+    for (int i = 0; i < bn; i ++)
+    {
+        bool take_left = left[i] < right[i];
+        min[i] = take_left ? left[i] : right[i];
+        if (selector != nullptr) { (*selector)[i] = take_left ? 1 : 0; }
+    }
+#else
+    OBLIVC_MIN_IO io = {0};
+    vector<OBLIVC_WIDE_TYPE> buff;
+    vector<int> bits;
+    min_io_init(io, buff, bits, bn);
+
+    // The masks of the min are subtracted again once it comes back.
+    vector<mpz_class> enc_min_mask(bn);
+    mpz_class mask, enc_mask;
+
+    int head[2] = {bn, selector != nullptr};
+    auto comm_start = chrono::high_resolution_clock::now();
+    boost::system::error_code ec;
+    boost::asio::write(sock, boost::asio::buffer(reinterpret_cast<char*>(head), sizeof(head)), ec);
+    if (ec) { throw sec_gdb_network_exception("Sending secure min size failed!", ec.value()); }
+    g_cmp_comm_time += chrono::duration<double>(chrono::high_resolution_clock::now() - comm_start).count();
+
+    for (int i = 0; i < bn; i ++)
+    {
+        blinding_mask(jl_pk, width_bits(width) - 2, mask, enc_mask);
+        io.r_1[i] = mask.get_si();
+        mpz_class blinded_left = JL_homo_add(jl_pk, left[i], enc_mask);
+
+        blinding_mask(jl_pk, width_bits(width) - 2, mask, enc_mask);
+        io.r_2[i] = mask.get_si();
+        mpz_class blinded_right = JL_homo_add(jl_pk, right[i], enc_mask);
+
+        blinding_mask(jl_pk, width_bits(width) - 2, mask, enc_min_mask[i]);
+        io.r_3[i] = mask.get_si();
+
+        gen_random_single(mask, 1);
+        io.s[i] = mask.get_si();
+
+        comm_start = chrono::high_resolution_clock::now();
+        net_send_mpz_class(sock, blinded_left);
+        net_send_mpz_class(sock, blinded_right);
+        g_cmp_comm_time += chrono::duration<double>(chrono::high_resolution_clock::now() - comm_start).count();
+    }
+
+    ProtocolDesc pd = {0};
+    protocolUseTcp2PKeepAlive(&pd, sock.native_handle(), true);
+    setCurrentParty(&pd, SEC_GDB_OBLIVC_SERVER);
+    execYaoProtocol(&pd, width_circuit(min_circuits, width), &io);
+    cleanupProtocol(&pd);
+
+    mpz_class one(1), enc_one;
+    if (selector != nullptr) { JL_encryption(jl_pk, one, enc_one); }
+    mpz_class enc;
+    for (int i = 0; i < bn; i ++)
+    {
+        net_recv_mpz_class(sock, enc);
+        min[i] = JL_homo_sub(jl_pk, enc, enc_min_mask[i]);
+        if (selector != nullptr)
+        {
+            // The proxy flipped the selector with s.
+            net_recv_mpz_class(sock, enc);
+            (*selector)[i] = io.s[i] ? JL_homo_sub(jl_pk, enc_one, enc) : enc;
+        }
+    }
+#endif //SEC_GDB_WITHOUT_ENCRYPTION
+
+    auto end_time = chrono::high_resolution_clock::now();
+    g_min_time_cost += chrono::duration<double>(end_time - start_time).count();
+}
+
 
 void secure_multiply_remote(JL_PK& jl_pk, JL_SK& jl_sk, tcp::socket& sock)
 {
@@ -307,11 +712,10 @@ mpz_class secure_multiply(JL_PK& jl_pk, mpz_class& left, mpz_class& right, tcp::
 //     log_dbg_fmt("Original r: %s l: %s\n", l.get_str().c_str(), r.get_str().c_str());
 // #endif
     
-    gen_random(r_left, r_right, sizeof(OBLIVC_DATA_TYPE) * 4 - 1); // in case of overflow
+    // in case of overflow
+    blinding_mask(jl_pk, sizeof(OBLIVC_DATA_TYPE) * 4 - 1, r_left, r_left_enc);
+    blinding_mask(jl_pk, sizeof(OBLIVC_DATA_TYPE) * 4 - 1, r_right, r_right_enc);
     log_dbg_fmt("r1 %s r2 %s\n", r_left.get_str().c_str(), r_right.get_str().c_str());
-    
-    JL_encryption(jl_pk, r_left, r_left_enc);
-    JL_encryption(jl_pk, r_right, r_right_enc);
     mpz_class r_mul_tmp = r_left * r_right;
     JL_encryption(jl_pk, r_mul_tmp, r_mul);
 
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int threads) : workers(), tasks(), stop(false)
+{
+    for (int i = 1; i < threads; i++)
+    {
+        this->workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> lck(this->mtx);
+        this->stop = true;
+    }
+    this->cv.notify_all();
+    for (auto &w : this->workers)
+    {
+        w.join();
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lck(this->mtx);
+            this->cv.wait(lck, [this] { return this->stop || !this->tasks.empty(); });
+            if (this->stop && this->tasks.empty())
+            {
+                return;
+            }
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, size_t grain, const function<void(size_t, size_t, int)> &body)
+{
+    if (n == 0) { return; }
+    if (grain == 0) { grain = 1; }
+
+    size_t chunks = (n + grain - 1) / grain;
+    int slots = (int)std::min<size_t>(chunks, (size_t)this->size());
+
+    if (slots == 1)
+    {
+        body(0, n, 0);
+        return;
+    }
+
+    // Chunks are handed out dynamically, so a slot that drew a few
+    // high-degree vertices does not hold back the others.
+    // remaining is only touched under done_mtx, so the caller can not see it
+    // reach zero and drop the stack frame before the last slot is done with
+    // done_mtx and done_cv.
+    atomic<size_t> next(0);
+    int remaining = slots;
+    mutex done_mtx;
+    condition_variable done_cv;
+    exception_ptr error;
+
+    auto run_slot = [&](int slot) {
+        try
+        {
+            size_t begin;
+            while ((begin = next.fetch_add(grain)) < n)
+            {
+                body(begin, std::min(begin + grain, n), slot);
+            }
+        }
+        catch (...)
+        {
+            unique_lock<mutex> lck(done_mtx);
+            if (!error) { error = current_exception(); }
+            next.store(n);
+        }
+        unique_lock<mutex> lck(done_mtx);
+        if (--remaining == 0)
+        {
+            done_cv.notify_all();
+        }
+    };
+
+    {
+        unique_lock<mutex> lck(this->mtx);
+        for (int slot = 1; slot < slots; slot++)
+        {
+            this->tasks.push(std::bind(run_slot, slot));
+        }
+    }
+    this->cv.notify_all();
+
+    run_slot(0);
+
+    {
+        unique_lock<mutex> lck(done_mtx);
+        done_cv.wait(lck, [&remaining] { return remaining == 0; });
+    }
+
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+}